@@ -20,6 +20,13 @@
 #include <errno.h>
 #include <math.h>
 
+#ifdef __linux__
+  #include <linux/perf_event.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
+
 //#define cmp(a,b) (*(a) > *(b)) // uncomment for faster primitive comparisons
 
 const char *sorts[] = { "*", "qsort", "quadsort" };
@@ -55,6 +62,9 @@ const char *sorts[] = { "*", "qsort", "quadsort" };
 #if __has_include("quadsort.h")
   #include "quadsort.h" // curl "https://raw.githubusercontent.com/scandum/quadsort/master/src/quadsort.{c,h}" -o "quadsort.#1"
 #endif
+#if __has_include("quadsort_ext.h") && defined QUADSORT_MT
+  #include "quadsort_ext.h" // needs POSIX threads and pread
+#endif
 #if __has_include("skipsort.h")
   #include "skipsort.h" // curl "https://raw.githubusercontent.com/scandum/wolfsort/master/src/skipsort.{c,h}" -o "skipsort.#1"
 #endif
@@ -69,6 +79,9 @@ const char *sorts[] = { "*", "qsort", "quadsort" };
 
 #ifdef __GNUG__
   #include <algorithm>
+  #if __has_include("quadsort.hpp")
+    #include "quadsort.hpp" // add "cpp_quad" to sorts[] to benchmark
+  #endif
   #if __has_include("pdqsort.h")
     #include "pdqsort.h" // curl https://raw.githubusercontent.com/orlp/pdqsort/master/pdqsort.h > pdqsort.h
   #endif
@@ -81,6 +94,8 @@ const char *sorts[] = { "*", "qsort", "quadsort" };
   #endif
 #endif
 
+#include "bench_dist.h"
+
 #if __has_include("antiqsort.c")
   #include "antiqsort.c"
 #endif
@@ -99,6 +114,44 @@ size_t comparisons;
 
 #define NO_INLINE __attribute__ ((noinline))
 
+// --format=json prints one json object per test and line, --format=csv prints
+// a header followed by one row per test. Both hold every sample in seconds.
+// Compile with -DBENCH_FLAGS='"-O3 -march=native"' to record the flags used.
+
+#define FORMAT_TABLE 0
+#define FORMAT_JSON  1
+#define FORMAT_CSV   2
+
+int format;
+
+#if defined __clang__
+  #define BENCH_COMPILER "clang " __clang_version__
+#elif defined __GNUC__ && defined __cplusplus
+  #define BENCH_COMPILER "g++ " __VERSION__
+#elif defined __GNUC__
+  #define BENCH_COMPILER "gcc " __VERSION__
+#else
+  #define BENCH_COMPILER "unknown"
+#endif
+
+#ifndef BENCH_FLAGS
+  #define BENCH_FLAGS ""
+#endif
+
+// --perf counts hardware events with perf_event_open on linux. Like the timer
+// the counters run for the whole sample, and they're reported per element.
+
+#define PERF_EVENTS 6
+
+const char *perf_names[PERF_EVENTS] = { "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses", "dtlb_misses" };
+
+int perf;
+int perf_fd[PERF_EVENTS];
+
+// set when the next test starts a new markdown table
+
+int new_table = 1;
+
 // primitive type comparison functions
 
 NO_INLINE int cmp_int(const void * a, const void * b)
@@ -208,6 +261,37 @@ NO_INLINE int cmp_long_double_ptr(const void * a, const void * b)
 	return (*fa > *fb) - (*fa < *fb);
 }
 
+// record comparison function, validate() sorts records of every size quadsort
+// instantiates through it. It isn't marked noinline, so the compiler is free
+// to move the record reads around the element moves of the sort.
+
+typedef struct
+{
+	int key;
+	int index;
+} RECORD;
+
+int cmp_record(const void * a, const void * b)
+{
+	COMPARISON_PP;
+
+	return ((const RECORD *) a)->key > ((const RECORD *) b)->key;
+}
+
+// orders records by key and then by index, which is the order a stable sort
+// of freshly filled records gives
+
+int cmp_record_index(const void * a, const void * b)
+{
+	const RECORD *ra = (const RECORD *) a, *rb = (const RECORD *) b;
+
+	if (ra->key != rb->key)
+	{
+		return ra->key < rb->key ? -1 : 1;
+	}
+	return ra->index < rb->index ? -1 : ra->index > rb->index;
+}
+
 // c++ comparison functions
 
 #ifdef __GNUG__
@@ -242,11 +326,293 @@ void seed_rand(unsigned long long seed)
 	srand(seed);
 }
 
+// user space only, each event is opened on its own so the kernel can
+// multiplex them when there are fewer hardware counters than events
+
+void perf_open()
+{
+	int cnt, opened = 0;
+
+#ifdef __linux__
+	static const unsigned int type[PERF_EVENTS] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE };
+	static const unsigned long long config[PERF_EVENTS] =
+	{
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_BRANCH_MISSES,
+		PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+		PERF_COUNT_HW_CACHE_LL | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+		PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16
+	};
+	struct perf_event_attr attr;
+
+	for (cnt = 0 ; cnt < PERF_EVENTS ; cnt++)
+	{
+		memset(&attr, 0, sizeof(attr));
+
+		attr.size = sizeof(attr);
+		attr.type = type[cnt];
+		attr.config = config[cnt];
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		perf_fd[cnt] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+		opened += perf_fd[cnt] != -1;
+	}
+#else
+	for (cnt = 0 ; cnt < PERF_EVENTS ; cnt++)
+	{
+		perf_fd[cnt] = -1;
+	}
+#endif
+	if (opened == 0)
+	{
+		fprintf(stderr, "perf: no hardware counters available (%s), see /proc/sys/kernel/perf_event_paranoid\n", strerror(errno));
+
+		perf = 0;
+	}
+}
+
+void perf_close()
+{
+	int cnt;
+
+	for (cnt = 0 ; cnt < PERF_EVENTS ; cnt++)
+	{
+		if (perf_fd[cnt] != -1)
+		{
+			close(perf_fd[cnt]);
+		}
+	}
+}
+
+void perf_start()
+{
+#ifdef __linux__
+	int cnt;
+
+	for (cnt = 0 ; cnt < PERF_EVENTS ; cnt++)
+	{
+		if (perf_fd[cnt] != -1)
+		{
+			ioctl(perf_fd[cnt], PERF_EVENT_IOC_RESET, 0);
+			ioctl(perf_fd[cnt], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+#endif
+}
+
+// adds the events since perf_start() to counts, scaled up when multiplexed
+
+void perf_stop(double *counts)
+{
+#ifdef __linux__
+	unsigned long long value[3];
+	int cnt;
+
+	for (cnt = 0 ; cnt < PERF_EVENTS ; cnt++)
+	{
+		if (perf_fd[cnt] != -1)
+		{
+			ioctl(perf_fd[cnt], PERF_EVENT_IOC_DISABLE, 0);
+		}
+	}
+
+	for (cnt = 0 ; cnt < PERF_EVENTS ; cnt++)
+	{
+		if (perf_fd[cnt] != -1 && read(perf_fd[cnt], value, sizeof(value)) == sizeof(value) && value[2])
+		{
+			counts[cnt] += (double) value[0] * value[1] / value[2];
+		}
+	}
+#endif
+}
+
+// the compile flags given with BENCH_FLAGS, followed by the defines that
+// change how quadsort is built
+
+const char *build_flags()
+{
+	static char flags[200];
+
+	strcpy(flags, BENCH_FLAGS);
+#ifdef __OPTIMIZE__
+	strcat(flags, *flags ? " __OPTIMIZE__" : "__OPTIMIZE__");
+#endif
+#ifdef __AVX2__
+	strcat(flags, *flags ? " __AVX2__" : "__AVX2__");
+#endif
+#ifdef cmp
+	strcat(flags, *flags ? " cmp" : "cmp");
+#endif
+#ifdef QUADSORT_STATS
+	strcat(flags, *flags ? " QUADSORT_STATS" : "QUADSORT_STATS");
+#endif
+	return flags;
+}
+
+// the nearest rank percentile of a sorted list of sample times
+
+long long percentile(long long *times, int samples, int percent)
+{
+	int rank = (samples * percent + 99) / 100;
+
+	return times[rank > 0 ? rank - 1 : 0];
+}
+
+// Newton's method, so the benchmark doesn't need to be linked with -lm
+
+double std_dev(long long *times, int samples)
+{
+	double mean = 0, variance = 0, root;
+	int cnt;
+
+	for (cnt = 0 ; cnt < samples ; cnt++)
+	{
+		mean += times[cnt];
+	}
+	mean /= samples;
+
+	for (cnt = 0 ; cnt < samples ; cnt++)
+	{
+		variance += (times[cnt] - mean) * (times[cnt] - mean);
+	}
+	variance /= samples;
+
+	if (variance == 0)
+	{
+		return 0;
+	}
+
+	for (root = variance > 1 ? variance : 1, cnt = 0 ; cnt < 100 ; cnt++)
+	{
+		root = (root + variance / root) / 2;
+	}
+	return root;
+}
+
+// the perf columns of the markdown table, rates below 0 weren't counted
+
+void perf_table(char *text, double *rates)
+{
+	int cnt;
+
+	*text = 0;
+
+	if (perf == 0)
+	{
+		return;
+	}
+
+	for (cnt = 0 ; cnt < PERF_EVENTS ; cnt++)
+	{
+		if (rates == NULL)
+		{
+			strcat(text, "          |");
+		}
+		else if (rates[cnt] < 0)
+		{
+			strcat(text, "        - |");
+		}
+		else
+		{
+			sprintf(text + strlen(text), " %8.3f |", rates[cnt]);
+		}
+	}
+}
+
+void print_record(const char *name, int maximum, size_t size, long long *times, int samples, int repetitions, double compares, const char *desc, int stable, double *rates)
+{
+	static char header = 0;
+	long long *sorted = (long long *) malloc(samples * sizeof(long long));
+	long long best, total = 0;
+	int cnt;
+
+	memcpy(sorted, times, samples * sizeof(long long));
+	quadsort_prim(sorted, samples, sizeof(long long));
+
+	for (cnt = 0 ; cnt < samples ; cnt++)
+	{
+		total += times[cnt];
+	}
+	best = sorted[0];
+
+	if (format == FORMAT_JSON)
+	{
+		printf("{\"sort\": \"%s\", \"items\": %d, \"size\": %d, \"distribution\": \"%s\", \"samples\": %d, \"repetitions\": %d, ", name, maximum, (int) size, desc, samples, repetitions);
+		printf("\"best\": %f, \"average\": %f, \"p50\": %f, \"p90\": %f, \"p99\": %f, \"stddev\": %f, ", best / 1000000.0, total / 1000000.0 / samples, percentile(sorted, samples, 50) / 1000000.0, percentile(sorted, samples, 90) / 1000000.0, percentile(sorted, samples, 99) / 1000000.0, std_dev(times, samples) / 1000000.0);
+		printf("\"compares\": %.1f, \"stable\": %s, \"compiler\": \"%s\", \"flags\": \"%s\", ", compares, stable ? "true" : "false", BENCH_COMPILER, build_flags());
+
+		for (cnt = 0 ; perf && cnt < PERF_EVENTS ; cnt++)
+		{
+			if (rates[cnt] < 0)
+			{
+				printf("\"%s\": null, ", perf_names[cnt]);
+			}
+			else
+			{
+				printf("\"%s\": %f, ", perf_names[cnt], rates[cnt]);
+			}
+		}
+		printf("\"times\": [");
+
+		for (cnt = 0 ; cnt < samples ; cnt++)
+		{
+			printf(cnt ? ", %f" : "%f", times[cnt] / 1000000.0);
+		}
+		printf("]}\n");
+	}
+	else
+	{
+		if (header == 0)
+		{
+			header = 1;
+			printf("sort,items,size,distribution,samples,repetitions,best,average,p50,p90,p99,stddev,compares,stable,compiler,flags,");
+
+			for (cnt = 0 ; perf && cnt < PERF_EVENTS ; cnt++)
+			{
+				printf("%s,", perf_names[cnt]);
+			}
+			printf("times\n");
+		}
+		printf("%s,%d,%d,\"%s\",%d,%d,", name, maximum, (int) size, desc, samples, repetitions);
+		printf("%f,%f,%f,%f,%f,%f,", best / 1000000.0, total / 1000000.0 / samples, percentile(sorted, samples, 50) / 1000000.0, percentile(sorted, samples, 90) / 1000000.0, percentile(sorted, samples, 99) / 1000000.0, std_dev(times, samples) / 1000000.0);
+		printf("%.1f,%d,\"%s\",\"%s\",", compares, stable, BENCH_COMPILER, build_flags());
+
+		for (cnt = 0 ; perf && cnt < PERF_EVENTS ; cnt++)
+		{
+			if (rates[cnt] < 0)
+			{
+				printf(",");
+			}
+			else
+			{
+				printf("%f,", rates[cnt]);
+			}
+		}
+		printf("\"");
+
+		for (cnt = 0 ; cnt < samples ; cnt++)
+		{
+			printf(cnt ? " %f" : "%f", times[cnt] / 1000000.0);
+		}
+		printf("\"\n");
+	}
+	free(sorted);
+}
+
 void test_sort(void *array, void *unsorted, void *valid, int minimum, int maximum, int samples, int repetitions, SRTFUNC *srt, const char *name, const char *desc, size_t size, CMPFUNC *cmpf)
 {
-	long long start, end, total, best, average_time, average_comp;
-	char temp[100];
+	long long start, end, total, best, average_time, average_comp, elements;
+	double counts[PERF_EVENTS] = { 0 }, rates[PERF_EVENTS];
+	char temp[100], columns[100];
 	static char compare = 0;
+	static long long *times = NULL;
+	static int times_size = 0;
+	int stable = 1;
 	long long *ptla = (long long *) array, *ptlv = (long long *) valid;
 	long double *ptda = (long double *) array, *ptdv = (long double *) valid;
 	int *pta = (int *) array, *ptv = (int *) valid, rep, sam, max, cnt, name32;
@@ -257,30 +623,44 @@ void test_sort(void *array, void *unsorted, void *valid, int minimum, int maximu
 
 	if (*name == '*')
 	{
-		if (!strcmp(desc, "random order") || !strcmp(desc, "random 1-4") || !strcmp(desc, "random 4") || !strcmp(desc, "random string") || !strcmp(desc, "random 10"))
+		if (format != FORMAT_TABLE)
 		{
+			return;
+		}
+
+		if (new_table)
+		{
+			new_table = 0;
+
 			if (comparisons)
 			{
 				compare = 1;
-				printf("%s\n", "|      Name |    Items | Type |     Best |  Average |  Compares | Samples |     Distribution |");
-				printf("%s\n", "| --------- | -------- | ---- | -------- | -------- | --------- | ------- | ---------------- |");
+				printf("%s%s\n", "|      Name |    Items | Type |     Best |  Average |  Compares | Samples |     Distribution |", perf ? "   Cycles |    Instr |   BrMiss |  L1DMiss |  LLCMiss | dTLBMiss |" : "");
+				printf("%s%s\n", "| --------- | -------- | ---- | -------- | -------- | --------- | ------- | ---------------- |", perf ? " -------- | -------- | -------- | -------- | -------- | -------- |" : "");
 			}
 			else
 			{
-				printf("%s\n", "|      Name |    Items | Type |     Best |  Average |     Loops | Samples |     Distribution |");
-				printf("%s\n", "| --------- | -------- | ---- | -------- | -------- | --------- | ------- | ---------------- |");
+				printf("%s%s\n", "|      Name |    Items | Type |     Best |  Average |     Loops | Samples |     Distribution |", perf ? "   Cycles |    Instr |   BrMiss |  L1DMiss |  LLCMiss | dTLBMiss |" : "");
+				printf("%s%s\n", "| --------- | -------- | ---- | -------- | -------- | --------- | ------- | ---------------- |", perf ? " -------- | -------- | -------- | -------- | -------- | -------- |" : "");
 			}
 		}
 		else
 		{
-				printf("%s\n", "|           |          |      |          |          |           |         |                  |");
+				perf_table(columns, NULL);
+				printf("%s%s\n", "|           |          |      |          |          |           |         |                  |", columns);
 		}
 		return;
 	}
 
 	name32 = name[0] + (name[1] ? name[1] * 32 : 0) + (name[2] ? name[2] * 1024 : 0);
 
-	best = average_time = average_comp = 0;
+	best = average_time = average_comp = elements = 0;
+
+	if (samples > times_size)
+	{
+		times_size = samples;
+		times = (long long *) realloc(times, times_size * sizeof(long long));
+	}
 
 	if (minimum == 7 && maximum == 7)
 	{
@@ -294,6 +674,10 @@ void test_sort(void *array, void *unsorted, void *valid, int minimum, int maximu
 		total = average_comp = 0;
 		max = minimum;
 
+		if (perf)
+		{
+			perf_start();
+		}
 		start = utime();
 
 		for (rep = repetitions - 1 ; rep >= 0 ; rep--)
@@ -352,6 +736,9 @@ void test_sort(void *array, void *unsorted, void *valid, int minimum, int maximu
 				case 's' + 'o' * 32 + 'r' * 1024: if (size == sizeof(int)) std::sort(pta, pta + max); else if (size == sizeof(long long)) std::sort(ptla, ptla + max); else std::sort(ptda, ptda + max); break;
 				case 's' + 't' * 32 + 'a' * 1024: if (size == sizeof(int)) std::stable_sort(pta, pta + max); else if (size == sizeof(long long)) std::stable_sort(ptla, ptla + max); else std::stable_sort(ptda, ptda + max); break;
 
+  #ifdef QUADSORT_HPP
+				case 'c' + 'p' * 32 + 'p' * 1024: if (size == sizeof(int)) quadsort::sort(pta, pta + max); else if (size == sizeof(long long)) quadsort::sort(ptla, ptla + max); else quadsort::sort(ptda, ptda + max); break;
+  #endif
   #ifdef PDQSORT_H
 				case 'p' + 'd' * 32 + 'q' * 1024: if (size == sizeof(int)) pdqsort(pta, pta + max); else if (size == sizeof(long long)) pdqsort(ptla, ptla + max); else pdqsort(ptda, ptda + max); break;
   #endif
@@ -367,6 +754,7 @@ void test_sort(void *array, void *unsorted, void *valid, int minimum, int maximu
 					{
 						case 's' + 'o' * 32 + 'r' * 1024:
 						case 's' + 't' * 32 + 'a' * 1024:
+						case 'c' + 'p' * 32 + 'p' * 1024:
 						case 'p' + 'd' * 32 + 'q' * 1024: 
 						case 'r' + 'h' * 32 + 's' * 1024:
 						case 's' + 'k' * 32 + 'a' * 1024:
@@ -379,6 +767,7 @@ void test_sort(void *array, void *unsorted, void *valid, int minimum, int maximu
 					}
 			}
 			average_comp += comparisons;
+			elements += max;
 
 			if (minimum < maximum && ++max > maximum)
 			{
@@ -387,8 +776,14 @@ void test_sort(void *array, void *unsorted, void *valid, int minimum, int maximu
 		}
 		end = utime();
 
+		if (perf)
+		{
+			perf_stop(counts);
+		}
 		total = end - start;
 
+		times[sam] = total;
+
 		if (!best || total < best)
 		{
 			best = total;
@@ -414,27 +809,42 @@ void test_sort(void *array, void *unsorted, void *valid, int minimum, int maximu
 		{
 			if (pta[cnt - 1] > pta[cnt])
 			{
-				sprintf(temp, "\e[1;31m%16s\e[0m", "unstable");
-				desc = temp;
+				stable = 0;
 				break;
 			}
 		}
 	}
 
-	if (compare)
+	if (stable == 0 && format == FORMAT_TABLE)
+	{
+		sprintf(temp, "\e[1;31m%16s\e[0m", "unstable");
+		desc = temp;
+	}
+
+	for (cnt = 0 ; cnt < PERF_EVENTS ; cnt++)
+	{
+		rates[cnt] = perf_fd[cnt] == -1 || elements == 0 ? -1 : counts[cnt] / elements;
+	}
+	perf_table(columns, rates);
+
+	if (format != FORMAT_TABLE)
+	{
+		print_record(name, maximum, size, times, samples, repetitions, repetitions <= 1 ? (double) comparisons : (double) average_comp / repetitions, desc, stable, rates);
+	}
+	else if (compare)
 	{
 		if (repetitions <= 1)
 		{
-			printf("|%10s |%9d | %4d |%9f |%9f |%10d | %7d | %16s |\e[0m\n", name, maximum, (int) size * 8, best / 1000000.0, average_time / 1000000.0, (int) comparisons, samples, desc);
+			printf("|%10s |%9d | %4d |%9f |%9f |%10d | %7d | %16s |%s\e[0m\n", name, maximum, (int) size * 8, best / 1000000.0, average_time / 1000000.0, (int) comparisons, samples, desc, columns);
 		}
 		else
 		{
-			printf("|%10s |%9d | %4d |%9f |%9f |%10.1f | %7d | %16s |\e[0m\n", name, maximum, (int) size * 8, best / 1000000.0, average_time / 1000000.0, (float) average_comp / repetitions, samples, desc);
+			printf("|%10s |%9d | %4d |%9f |%9f |%10.1f | %7d | %16s |%s\e[0m\n", name, maximum, (int) size * 8, best / 1000000.0, average_time / 1000000.0, (float) average_comp / repetitions, samples, desc, columns);
 		}
 	}
 	else
 	{
-		printf("|%10s | %8d | %4d | %f | %f | %9d | %7d | %16s |\e[0m\n", name, maximum, (int) size * 8, best / 1000000.0, average_time / 1000000.0, repetitions, samples, desc);
+		printf("|%10s | %8d | %4d | %f | %f | %9d | %7d | %16s |%s\e[0m\n", name, maximum, (int) size * 8, best / 1000000.0, average_time / 1000000.0, repetitions, samples, desc, columns);
 	}
 
 	if (minimum != maximum || cmpf == cmp_stable)
@@ -567,74 +977,702 @@ void test_sort(void *array, void *unsorted, void *valid, int minimum, int maximu
 	}
 }
 
-void validate()
+// fills records of size bytes with keys below keys, the bytes past the
+// record hold a copy of its index
+
+void fill_records(char *records, int nmemb, int size, int keys)
 {
-	int seed = time(NULL);
-	int cnt, val, max = 1000;
+	RECORD *ptr;
+	int cnt;
 
-	int *a_array, *r_array, *v_array;
+	for (cnt = 0 ; cnt < nmemb ; cnt++)
+	{
+		memset(records + cnt * size, cnt, size);
 
-	seed_rand(seed);
+		ptr = (RECORD *) (records + cnt * size);
 
-	a_array = (int *) malloc(max * sizeof(int));
-	r_array = (int *) malloc(max * sizeof(int));
-	v_array = (int *) malloc(max * sizeof(int));
+		ptr->key = rand() % keys;
+		ptr->index = cnt;
+	}
+}
 
-	for (cnt = 0 ; cnt < max ; cnt++) r_array[cnt] = rand();
+// returns the index of the first record that isn't in stable order or whose
+// bytes didn't survive, or -1
 
-	for (cnt = 0 ; cnt < max ; cnt++)
-	{
-		memcpy(a_array, r_array, cnt * sizeof(int));
-		memcpy(v_array, r_array, cnt * sizeof(int));
+int check_records(char *records, int nmemb, int size)
+{
+	RECORD *ptr, *prev;
+	int cnt;
 
-		quadsort_prim(a_array, cnt, sizeof(int));
-		qsort(v_array, cnt, sizeof(int), cmp_int);
+	for (cnt = 0 ; cnt < nmemb ; cnt++)
+	{
+		ptr = (RECORD *) (records + cnt * size);
+		prev = (RECORD *) (records + (cnt - 1) * size);
 
-		for (val = 0 ; val < cnt ; val++)
+		if (cnt && (prev->key > ptr->key || (prev->key == ptr->key && prev->index > ptr->index)))
 		{
-			if (val && v_array[val - 1] > v_array[val]) {printf("\e[1;31mvalidate rand: seed %d: size: %d Not properly sorted at index %d.\n", seed, cnt, val); return;}
-			if (a_array[val] != v_array[val])           {printf("\e[1;31mvalidate rand: seed %d: size: %d Not verified at index %d.\n", seed, cnt, val); return;}
+			return cnt;
+		}
+		if (records[(cnt + 1) * size - 1] != (char) (size > (int) sizeof(RECORD) ? ptr->index : 0))
+		{
+			return cnt;
 		}
 	}
+	return -1;
+}
 
-	// ascending saw
-
-	for (cnt = 0 ; cnt < max ; cnt++) r_array[cnt] = cnt % (max / 5);
+// quadsort_merge_k() of sorted runs, a quarter of them empty, must give the
+// same bytes as quadsort() of their concatenation, so equal keys keep the
+// order of the runs. 28 byte records use the loser tree.
 
-	for (cnt = 0 ; cnt < max ; cnt += 7)
-	{
-		memcpy(a_array, r_array, cnt * sizeof(int));
-		memcpy(v_array, r_array, cnt * sizeof(int));
+void validate_merge_k(int seed)
+{
+	int sizes[] = { 8, 12, 20, 28 }, counts[] = { 1, 2, 3, 7, 40 };
+	int size, count, run, total;
+	const void *runs[40];
+	size_t lens[40];
+	char *a_array, *r_array, *v_array;
 
-		quadsort(a_array, cnt, sizeof(int), cmp_int);
-		qsort(v_array, cnt, sizeof(int), cmp_int);
+	a_array = (char *) malloc(40 * 300 * 28);
+	r_array = (char *) malloc(40 * 300 * 28);
+	v_array = (char *) malloc(40 * 300 * 28);
 
-		for (val = 0 ; val < cnt ; val++)
+	for (size = 0 ; size < 4 ; size++)
+	{
+		for (count = 0 ; count < 5 ; count++)
 		{
-			if (val && v_array[val - 1] > v_array[val]) {printf("\e[1;31mvalidate ascending saw: seed %d: size: %d Not properly sorted at index %d.\n", seed, cnt, val); return;}
-			if (a_array[val] != v_array[val])           {printf("\e[1;31mvalidate ascending saw: seed %d: size: %d Not verified at index %d.\n", seed, cnt, val); return;}
-		}
-	}
+			for (run = total = 0 ; run < counts[count] ; run++)
+			{
+				lens[run] = rand() % 4 ? rand() % 300 : 0;
+				total += lens[run];
+			}
+			fill_records(r_array, total, sizes[size], 50);
 
-	// descending saw
+			memcpy(v_array, r_array, total * sizes[size]);
 
-	for (cnt = 0 ; cnt < max ; cnt++)
-	{
-		r_array[cnt] = (max - cnt + 1) % (max / 11);
-	}
+			for (run = total = 0 ; run < counts[count] ; run++)
+			{
+				runs[run] = r_array + total * sizes[size];
 
-	for (cnt = 1 ; cnt < max ; cnt += 7)
-	{
-		memcpy(a_array, r_array, cnt * sizeof(int));
-		memcpy(v_array, r_array, cnt * sizeof(int));
+				quadsort(r_array + total * sizes[size], lens[run], sizes[size], cmp_record);
 
-		quadsort(a_array, cnt, sizeof(int), cmp_int);
-		qsort(v_array, cnt, sizeof(int), cmp_int);
+				total += lens[run];
+			}
+			quadsort(v_array, total, sizes[size], cmp_record);
 
-		for (val = 0 ; val < cnt ; val++)
-		{
-			if (val && v_array[val - 1] > v_array[val]) {printf("\e[1;31mvalidate descending saw: seed %d: size: %d Not properly sorted at index %d.\n\n", seed, cnt, val); return;}
-			if (a_array[val] != v_array[val])           {printf("\e[1;31mvalidate descending saw: seed %d: size: %d Not verified at index %d.\n\n", seed, cnt, val); return;}
+			quadsort_merge_k(runs, lens, counts[count], a_array, sizes[size], cmp_record);
+
+			if (memcmp(a_array, v_array, total * sizes[size])) {printf("\e[1;31mvalidate quadsort_merge_k: seed %d: size: %d runs: %d Not identical to quadsort.\n", seed, sizes[size], counts[count]); return;}
+		}
+	}
+	free(a_array);
+	free(r_array);
+	free(v_array);
+}
+
+// quadsort_partial() must leave the first k records of a stable sort at the
+// front, with the rest of the records still present behind them. k = 512 is
+// where the staging area grows past its minimum, and descending keys stage
+// every record.
+
+void validate_partial(int seed)
+{
+	int sizes[] = { 8, 12, 28 }, nmemb = 4000;
+	size_t ks[] = { 0, 1, 511, 512, 513, 1999, 4000 };
+	int size, cnt, keys, rec;
+	char *a_array, *v_array;
+
+	a_array = (char *) malloc(nmemb * 28);
+	v_array = (char *) malloc(nmemb * 28);
+
+	for (size = 0 ; size < 3 ; size++)
+	{
+		for (cnt = 0 ; cnt < 7 * 3 ; cnt++)
+		{
+			keys = cnt % 3;
+
+			fill_records(a_array, nmemb, sizes[size], keys == 1 ? 20 : nmemb);
+
+			for (rec = 0 ; keys == 2 && rec < nmemb ; rec++)
+			{
+				((RECORD *) (a_array + rec * sizes[size]))->key = nmemb - rec;
+			}
+
+			memcpy(v_array, a_array, nmemb * sizes[size]);
+
+			quadsort(v_array, nmemb, sizes[size], cmp_record);
+
+			quadsort_partial(a_array, nmemb, ks[cnt / 3], sizes[size], cmp_record);
+
+			if (memcmp(a_array, v_array, ks[cnt / 3] * sizes[size])) {printf("\e[1;31mvalidate quadsort_partial: seed %d: size: %d k: %zu Prefix not identical to quadsort.\n", seed, sizes[size], ks[cnt / 3]); return;}
+
+			quadsort(a_array, nmemb, sizes[size], cmp_record_index);
+
+			if (memcmp(a_array, v_array, nmemb * sizes[size])) {printf("\e[1;31mvalidate quadsort_partial: seed %d: size: %d k: %zu Records lost.\n", seed, sizes[size], ks[cnt / 3]); return;}
+		}
+	}
+	free(a_array);
+	free(v_array);
+}
+
+// after quadsort_quantiles() the record at each rank must be the one a stable
+// sort puts there, with only records that sort before it on its left and
+// only records that sort after it on its right. Ranks of nmemb or above must
+// be ignored, and 28 byte records are sorted as a whole.
+
+void validate_select(int seed)
+{
+	int sizes[] = { 8, 12, 20, 28 }, nmemb = 3000;
+	size_t ranks[7];
+	int size, cnt, rank, rec, *i_array, *i_sorted;
+	double *d_array, *d_sorted;
+	char *a_array, *r_array, *v_array, *pivot;
+
+	a_array = (char *) malloc(nmemb * 28);
+	r_array = (char *) malloc(nmemb * 28);
+	v_array = (char *) malloc(nmemb * 28);
+
+	for (size = 0 ; size < 4 ; size++)
+	{
+		for (cnt = 0 ; cnt < 4 ; cnt++)
+		{
+			fill_records(a_array, nmemb, sizes[size], cnt & 1 ? 20 : nmemb);
+
+			memcpy(r_array, a_array, nmemb * sizes[size]);
+			memcpy(v_array, a_array, nmemb * sizes[size]);
+
+			quadsort(v_array, nmemb, sizes[size], cmp_record);
+
+			ranks[0] = nmemb;
+			ranks[1] = rand() % nmemb;
+			ranks[2] = ranks[1];
+			ranks[3] = 0;
+			ranks[4] = nmemb - 1;
+			ranks[5] = rand() % nmemb;
+			ranks[6] = nmemb + 5;
+
+			if (cnt < 2)
+			{
+				quadsort_quantiles(a_array, nmemb, ranks, 7, sizes[size], cmp_record);
+			}
+			else
+			{
+				quadsort_select(a_array, nmemb, ranks[5], sizes[size], cmp_record);
+			}
+
+			for (rank = cnt < 2 ? 1 : 5 ; rank < 6 ; rank++)
+			{
+				pivot = a_array + ranks[rank] * sizes[size];
+
+				if (memcmp(pivot, v_array + ranks[rank] * sizes[size], sizes[size])) {printf("\e[1;31mvalidate quadsort_quantiles: seed %d: size: %d rank: %zu Not identical to quadsort.\n", seed, sizes[size], ranks[rank]); return;}
+
+				for (rec = 0 ; rec < nmemb ; rec++)
+				{
+					if ((rec < (int) ranks[rank]) != (cmp_record_index(a_array + rec * sizes[size], pivot) < 0) && rec != (int) ranks[rank]) {printf("\e[1;31mvalidate quadsort_quantiles: seed %d: size: %d rank: %zu Not partitioned at index %d.\n", seed, sizes[size], ranks[rank], rec); return;}
+				}
+			}
+			quadsort(a_array, nmemb, sizes[size], cmp_record_index);
+
+			if (memcmp(a_array, v_array, nmemb * sizes[size])) {printf("\e[1;31mvalidate quadsort_quantiles: seed %d: size: %d Records lost.\n", seed, sizes[size]); return;}
+
+			if (sizes[size] != 28)
+			{
+				memcpy(a_array, r_array, nmemb * sizes[size]);
+
+				quadsort_quantiles(a_array, nmemb, ranks + 6, 1, sizes[size], cmp_record);
+
+				if (memcmp(a_array, r_array, nmemb * sizes[size])) {printf("\e[1;31mvalidate quadsort_quantiles: seed %d: size: %d Out of range rank not ignored.\n", seed, sizes[size]); return;}
+			}
+		}
+	}
+	free(a_array);
+	free(r_array);
+	free(v_array);
+
+	// the prim variant checks values, doubles in totalOrder
+
+	i_array = (int *) malloc(nmemb * sizeof(int));
+	i_sorted = (int *) malloc(nmemb * sizeof(int));
+	d_array = (double *) malloc(nmemb * sizeof(double));
+	d_sorted = (double *) malloc(nmemb * sizeof(double));
+
+	for (rec = 0 ; rec < nmemb ; rec++)
+	{
+		i_array[rec] = i_sorted[rec] = rand() % 100 - 50;
+		d_array[rec] = d_sorted[rec] = (rand() % 2000 - 1000) / 7.0;
+	}
+	quadsort_prim(i_sorted, nmemb, 4);
+	quadsort_prim(d_sorted, nmemb, 7);
+
+	quadsort_quantiles_prim(i_array, nmemb, ranks, 7, 4);
+	quadsort_quantiles_prim(d_array, nmemb, ranks, 7, 7);
+
+	for (rank = 1 ; rank < 6 ; rank++)
+	{
+		if (i_array[ranks[rank]] != i_sorted[ranks[rank]]) {printf("\e[1;31mvalidate quadsort_quantiles_prim: seed %d: int rank: %zu Not identical to quadsort_prim.\n", seed, ranks[rank]); return;}
+		if (d_array[ranks[rank]] != d_sorted[ranks[rank]]) {printf("\e[1;31mvalidate quadsort_quantiles_prim: seed %d: double rank: %zu Not identical to quadsort_prim.\n", seed, ranks[rank]); return;}
+
+		for (rec = 0 ; rec < nmemb ; rec++)
+		{
+			if (rec < (int) ranks[rank] ? i_array[rec] > i_array[ranks[rank]] : i_array[rec] < i_array[ranks[rank]]) {printf("\e[1;31mvalidate quadsort_quantiles_prim: seed %d: int rank: %zu Not partitioned at index %d.\n", seed, ranks[rank], rec); return;}
+			if (rec < (int) ranks[rank] ? d_array[rec] > d_array[ranks[rank]] : d_array[rec] < d_array[ranks[rank]]) {printf("\e[1;31mvalidate quadsort_quantiles_prim: seed %d: double rank: %zu Not partitioned at index %d.\n", seed, ranks[rank], rec); return;}
+		}
+	}
+	free(i_array);
+	free(i_sorted);
+	free(d_array);
+	free(d_sorted);
+}
+
+// an allocator that always fails, to reach the stack fallbacks
+
+void *alloc_fail(size_t size, void *ctx)
+{
+	return NULL;
+}
+
+void free_fail(void *ptr, void *ctx)
+{
+}
+
+// quadsort_append() of a sorted prefix and an unsorted tail must give the same
+// bytes as quadsort() of the whole array, also when the swap allocation fails
+// and a tail of more than 512 records is merged through the stack buffer.
+// Sizes without an instantiation have no fallback and are skipped then.
+
+void validate_append(int seed)
+{
+	int sizes[] = { 8, 12, 28 }, nmemb = 3000;
+	size_t blocks[] = { 0, 3000, 2995, 1500, 2000 };
+	int size, cnt, fail;
+	char *a_array, *v_array;
+
+	a_array = (char *) malloc(nmemb * 28);
+	v_array = (char *) malloc(nmemb * 28);
+
+	for (fail = 0 ; fail < 2 ; fail++)
+	{
+		quadsort_set_allocator(fail ? alloc_fail : NULL, fail ? free_fail : NULL, NULL);
+
+		for (size = 0 ; size < 3 - fail ; size++)
+		{
+			for (cnt = 0 ; cnt < 5 * 2 ; cnt++)
+			{
+				fill_records(a_array, nmemb, sizes[size], cnt & 1 ? 20 : nmemb);
+
+				quadsort(a_array, blocks[cnt / 2], sizes[size], cmp_record);
+
+				memcpy(v_array, a_array, nmemb * sizes[size]);
+
+				quadsort(v_array, nmemb, sizes[size], cmp_record);
+
+				quadsort_append(a_array, blocks[cnt / 2], nmemb, sizes[size], cmp_record);
+
+				if (memcmp(a_array, v_array, nmemb * sizes[size])) {quadsort_set_allocator(NULL, NULL, NULL); printf("\e[1;31mvalidate quadsort_append: seed %d: size: %d block: %zu failing malloc: %d Not identical to quadsort.\n", seed, sizes[size], blocks[cnt / 2], fail); return;}
+			}
+		}
+	}
+	quadsort_set_allocator(NULL, NULL, NULL);
+
+	free(a_array);
+	free(v_array);
+}
+
+// quadsort_natural() must give the same bytes as quadsort() on the run
+// structured distributions it is meant for, with keys scaled down to about
+// 100 values as well so runs hold equal keys and descending runs aren't
+// strict.
+
+void validate_natural(int seed)
+{
+	DISTFUNC *funcs[] = { dist_sorted_runs, dist_sorted_runs, dist_pipe_organ, dist_ascending_saw, dist_descending_saw, dist_descending, dist_random_tail, dist_few_unique };
+	int params[] = { 1000, 10, 0, 0, 0, 0, 25, 8 };
+	int sizes[] = { 8, 12, 28 }, nmemb = 20000;
+	int size, dist, scale, rec;
+	long long *keys, low, high, div;
+	char *a_array, *v_array;
+
+	keys = (long long *) malloc(nmemb * sizeof(long long));
+	a_array = (char *) malloc(nmemb * 28);
+	v_array = (char *) malloc(nmemb * 28);
+
+	for (size = 0 ; size < 3 ; size++)
+	{
+		for (dist = 0 ; dist < 8 ; dist++)
+		{
+			for (scale = 0 ; scale < 2 ; scale++)
+			{
+				funcs[dist](keys, nmemb, nmemb, 0, params[dist]);
+
+				for (rec = 0, low = high = keys[0] ; rec < nmemb ; rec++)
+				{
+					low = keys[rec] < low ? keys[rec] : low;
+					high = keys[rec] > high ? keys[rec] : high;
+				}
+				div = scale ? (high - low) / 100 + 1 : 1;
+
+				fill_records(a_array, nmemb, sizes[size], 1);
+
+				for (rec = 0 ; rec < nmemb ; rec++)
+				{
+					((RECORD *) (a_array + rec * sizes[size]))->key = (int) ((keys[rec] - low) / div);
+				}
+				memcpy(v_array, a_array, nmemb * sizes[size]);
+
+				quadsort(v_array, nmemb, sizes[size], cmp_record);
+
+				quadsort_natural(a_array, nmemb, sizes[size], cmp_record);
+
+				if (memcmp(a_array, v_array, nmemb * sizes[size])) {printf("\e[1;31mvalidate quadsort_natural: seed %d: size: %d distribution: %d scaled: %d Not identical to quadsort.\n", seed, sizes[size], dist, scale); return;}
+			}
+		}
+	}
+	free(keys);
+	free(a_array);
+	free(v_array);
+}
+
+// stores a key of the quadsort_prim() type that sorts like val, which is
+// below 50. The unsigned keys use the top bit to catch signed comparisons.
+
+void fill_key(void *keys, int index, size_t key_type, int val)
+{
+	switch (key_type)
+	{
+		case 4: ((int *) keys)[index] = val - 25; break;
+		case 5: ((unsigned int *) keys)[index] = val * 0x4000000U; break;
+		case 6: ((float *) keys)[index] = (val - 25) / 4.0f; break;
+		case 7: ((double *) keys)[index] = (val - 25) / 4.0; break;
+		case 8: ((long long *) keys)[index] = (val - 25) * 0x100000000LL; break;
+		case 9: ((unsigned long long *) keys)[index] = val * 0x300000000000000ULL; break;
+	}
+}
+
+// the values quadsort_kv() moves along with duplicate keys must come out as a
+// qsort() of key and index orders them, and the keys must follow them
+
+void validate_kv(int seed)
+{
+	size_t key_sizes[] = { 0, 0, 0, 0, 4, 4, 4, 8, 8, 8 };
+	int nmembs[] = { 100, 5000 }, value_sizes[] = { 4, 8 };
+	int type, vsize, cnt, rec, nmemb, index;
+	char *keys, *values, *r_keys;
+	RECORD *ref;
+
+	keys = (char *) malloc(5000 * 8);
+	values = (char *) malloc(5000 * 8);
+	r_keys = (char *) malloc(5000 * 8);
+	ref = (RECORD *) malloc(5000 * sizeof(RECORD));
+
+	for (type = 4 ; type <= 9 ; type++)
+	{
+		for (vsize = 0 ; vsize < 2 ; vsize++)
+		{
+			for (cnt = 0 ; cnt < 2 ; cnt++)
+			{
+				nmemb = nmembs[cnt];
+
+				for (rec = 0 ; rec < nmemb ; rec++)
+				{
+					ref[rec].key = rand() % 50;
+					ref[rec].index = rec;
+
+					fill_key(keys, rec, type, ref[rec].key);
+
+					if (value_sizes[vsize] == 4)
+					{
+						((unsigned int *) values)[rec] = rec;
+					}
+					else
+					{
+						((unsigned long long *) values)[rec] = rec;
+					}
+				}
+				memcpy(r_keys, keys, nmemb * key_sizes[type]);
+
+				qsort(ref, nmemb, sizeof(RECORD), cmp_record_index);
+
+				quadsort_kv(keys, values, nmemb, type, value_sizes[vsize]);
+
+				for (rec = 0 ; rec < nmemb ; rec++)
+				{
+					index = value_sizes[vsize] == 4 ? (int) ((unsigned int *) values)[rec] : (int) ((unsigned long long *) values)[rec];
+
+					if (index != ref[rec].index || memcmp(keys + rec * key_sizes[type], r_keys + index * key_sizes[type], key_sizes[type])) {printf("\e[1;31mvalidate quadsort_kv: seed %d: key type: %d value size: %d nmemb: %d Not verified at index %d.\n", seed, type, value_sizes[vsize], nmemb, rec); return;}
+				}
+			}
+		}
+	}
+	free(keys);
+	free(values);
+	free(r_keys);
+	free(ref);
+}
+
+// the permutations of quadsort_argsort() and its 32 bit and prim variants must
+// be the indices of a qsort() by key and index, and leave the array untouched
+
+void validate_argsort(int seed)
+{
+	size_t key_sizes[] = { 0, 0, 0, 0, 4, 4, 0, 0, 8, 8 };
+	int sizes[] = { 8, 12, 28 }, types[] = { 4, 5, 8, 9 }, nmemb = 5000;
+	int size, type, rec;
+	size_t *perm;
+	unsigned int *perm32;
+	char *a_array, *r_array;
+	RECORD *ref;
+
+	a_array = (char *) malloc(nmemb * 28);
+	r_array = (char *) malloc(nmemb * 28);
+	perm = (size_t *) malloc(nmemb * sizeof(size_t));
+	perm32 = (unsigned int *) malloc(nmemb * sizeof(unsigned int));
+	ref = (RECORD *) malloc(nmemb * sizeof(RECORD));
+
+	for (size = 0 ; size < 3 ; size++)
+	{
+		fill_records(a_array, nmemb, sizes[size], 50);
+
+		memcpy(r_array, a_array, nmemb * sizes[size]);
+
+		for (rec = 0 ; rec < nmemb ; rec++)
+		{
+			ref[rec] = *(RECORD *) (a_array + rec * sizes[size]);
+		}
+		qsort(ref, nmemb, sizeof(RECORD), cmp_record_index);
+
+		quadsort_argsort(a_array, nmemb, sizes[size], cmp_record, perm);
+		quadsort_argsort32(a_array, nmemb, sizes[size], cmp_record, perm32);
+
+		if (memcmp(a_array, r_array, nmemb * sizes[size])) {printf("\e[1;31mvalidate quadsort_argsort: seed %d: size: %d Array modified.\n", seed, sizes[size]); return;}
+
+		for (rec = 0 ; rec < nmemb ; rec++)
+		{
+			if (perm[rec] != (size_t) ref[rec].index || perm32[rec] != (unsigned int) ref[rec].index) {printf("\e[1;31mvalidate quadsort_argsort: seed %d: size: %d Not verified at index %d.\n", seed, sizes[size], rec); return;}
+		}
+	}
+
+	for (type = 0 ; type < 4 ; type++)
+	{
+		for (rec = 0 ; rec < nmemb ; rec++)
+		{
+			ref[rec].key = rand() % 50;
+			ref[rec].index = rec;
+
+			fill_key(a_array, rec, types[type], ref[rec].key);
+		}
+		memcpy(r_array, a_array, nmemb * key_sizes[types[type]]);
+
+		qsort(ref, nmemb, sizeof(RECORD), cmp_record_index);
+
+		quadsort_argsort_prim(a_array, nmemb, types[type], perm);
+		quadsort_argsort_prim32(a_array, nmemb, types[type], perm32);
+
+		if (memcmp(a_array, r_array, nmemb * key_sizes[types[type]])) {printf("\e[1;31mvalidate quadsort_argsort_prim: seed %d: key type: %d Array modified.\n", seed, types[type]); return;}
+
+		for (rec = 0 ; rec < nmemb ; rec++)
+		{
+			if (perm[rec] != (size_t) ref[rec].index || perm32[rec] != (unsigned int) ref[rec].index) {printf("\e[1;31mvalidate quadsort_argsort_prim: seed %d: key type: %d Not verified at index %d.\n", seed, types[type], rec); return;}
+		}
+	}
+	free(a_array);
+	free(r_array);
+	free(perm);
+	free(perm32);
+	free(ref);
+}
+
+#ifdef QUADSORT_MT
+
+// quadsort_mt() must give the same bytes as quadsort() for any number of
+// threads, 12 byte records are sorted single threaded
+
+void validate_mt(int seed)
+{
+	int sizes[] = { 8, 12, 16 }, nmembs[] = { 140000, 400000 }, threads[] = { 1, 2, 3, 5 };
+	int size, nmemb, thread;
+	char *a_array, *v_array;
+
+	a_array = (char *) malloc(400000 * 16);
+	v_array = (char *) malloc(400000 * 16);
+
+	for (size = 0 ; size < 3 ; size++)
+	{
+		for (nmemb = 0 ; nmemb < 2 ; nmemb++)
+		{
+			fill_records(v_array, nmembs[nmemb], sizes[size], 1000);
+
+			for (thread = 0 ; thread < 4 ; thread++)
+			{
+				memcpy(a_array, v_array, nmembs[nmemb] * sizes[size]);
+
+				quadsort_mt(a_array, nmembs[nmemb], sizes[size], cmp_record, threads[thread]);
+
+				if (thread == 0)
+				{
+					quadsort(v_array, nmembs[nmemb], sizes[size], cmp_record);
+				}
+
+				if (memcmp(a_array, v_array, nmembs[nmemb] * sizes[size])) {printf("\e[1;31mvalidate quadsort_mt: seed %d: size: %d nmemb: %d threads: %d Not identical to quadsort.\n", seed, sizes[size], nmembs[nmemb], threads[thread]); return;}
+			}
+		}
+	}
+	free(a_array);
+	free(v_array);
+}
+
+#endif
+
+#ifdef QUADSORT_EXT_H
+
+// sorts a file in place with a memory budget that makes many runs, and
+// checks the result against quadsort(), followed by the errors for a
+// missing input and a size that doesn't divide the file size
+
+void validate_ext(int seed)
+{
+	char path[] = "/tmp/bench.XXXXXX";
+	int cnt, val, fd, nmemb = 100000, sizes[] = { 4, 12 };
+	char *a_array, *v_array;
+	FILE *file;
+
+	a_array = (char *) malloc(nmemb * 12);
+	v_array = (char *) malloc(nmemb * 12);
+
+	fd = mkstemp(path);
+
+	if (fd == -1)
+	{
+		printf("\e[1;31mvalidate quadsort_file: %s: %s\n", path, strerror(errno));
+		return;
+	}
+	close(fd);
+
+	for (cnt = 0 ; cnt < 2 ; cnt++)
+	{
+		if (sizes[cnt] == 4)
+		{
+			for (val = 0 ; val < nmemb ; val++) ((int *) v_array)[val] = rand() - RAND_MAX / 2;
+		}
+		else
+		{
+			fill_records(v_array, nmemb, sizes[cnt], 1000);
+		}
+		file = fopen(path, "wb");
+		fwrite(v_array, sizes[cnt], nmemb, file);
+		fclose(file);
+
+		if (sizes[cnt] == 4)
+		{
+			quadsort_prim(v_array, nmemb, 4);
+
+			val = quadsort_file_prim(path, path, 4, 16384);
+		}
+		else
+		{
+			quadsort(v_array, nmemb, sizes[cnt], cmp_record);
+
+			val = quadsort_file(path, path, sizes[cnt], cmp_record, 65536);
+		}
+		if (val) {printf("\e[1;31mvalidate quadsort_file: seed %d: size: %d %s.\n", seed, sizes[cnt], strerror(errno)); return;}
+
+		memset(a_array, 0, nmemb * sizes[cnt]);
+
+		file = fopen(path, "rb");
+		val = fread(a_array, sizes[cnt], nmemb + 1, file);
+		fclose(file);
+
+		if (val != nmemb || memcmp(a_array, v_array, nmemb * sizes[cnt])) {printf("\e[1;31mvalidate quadsort_file: seed %d: size: %d Not identical to quadsort.\n", seed, sizes[cnt]); return;}
+	}
+
+	// 100000 records of 12 bytes aren't a whole number of 4096 byte records
+
+	errno = 0;
+
+	if (quadsort_file(path, path, 4096, cmp_record, 65536) != -1 || errno != EINVAL) {printf("\e[1;31mvalidate quadsort_file: odd size: expected EINVAL, got %s.\n", strerror(errno)); return;}
+
+	unlink(path);
+
+	errno = 0;
+
+	if (quadsort_file(path, path, 12, cmp_record, 65536) != -1 || errno != ENOENT) {printf("\e[1;31mvalidate quadsort_file: missing input: expected ENOENT, got %s.\n", strerror(errno)); return;}
+
+	free(a_array);
+	free(v_array);
+}
+
+#endif
+
+void validate()
+{
+	int seed = time(NULL);
+	int cnt, val, max = 1000;
+	int *a_array, *r_array, *v_array;
+#ifndef cmp
+	int size, sizes[] = { 8, 12, 16, 20, 24, 32, 48 };
+	char *records;
+#endif
+
+	seed_rand(seed);
+
+	a_array = (int *) malloc(max * sizeof(int));
+	r_array = (int *) malloc(max * sizeof(int));
+	v_array = (int *) malloc(max * sizeof(int));
+
+	for (cnt = 0 ; cnt < max ; cnt++) r_array[cnt] = rand();
+
+	for (cnt = 0 ; cnt < max ; cnt++)
+	{
+		memcpy(a_array, r_array, cnt * sizeof(int));
+		memcpy(v_array, r_array, cnt * sizeof(int));
+
+		quadsort_prim(a_array, cnt, sizeof(int));
+		qsort(v_array, cnt, sizeof(int), cmp_int);
+
+		for (val = 0 ; val < cnt ; val++)
+		{
+			if (val && v_array[val - 1] > v_array[val]) {printf("\e[1;31mvalidate rand: seed %d: size: %d Not properly sorted at index %d.\n", seed, cnt, val); return;}
+			if (a_array[val] != v_array[val])           {printf("\e[1;31mvalidate rand: seed %d: size: %d Not verified at index %d.\n", seed, cnt, val); return;}
+		}
+	}
+
+	// ascending saw
+
+	for (cnt = 0 ; cnt < max ; cnt++) r_array[cnt] = cnt % (max / 5);
+
+	for (cnt = 0 ; cnt < max ; cnt += 7)
+	{
+		memcpy(a_array, r_array, cnt * sizeof(int));
+		memcpy(v_array, r_array, cnt * sizeof(int));
+
+		quadsort(a_array, cnt, sizeof(int), cmp_int);
+		qsort(v_array, cnt, sizeof(int), cmp_int);
+
+		for (val = 0 ; val < cnt ; val++)
+		{
+			if (val && v_array[val - 1] > v_array[val]) {printf("\e[1;31mvalidate ascending saw: seed %d: size: %d Not properly sorted at index %d.\n", seed, cnt, val); return;}
+			if (a_array[val] != v_array[val])           {printf("\e[1;31mvalidate ascending saw: seed %d: size: %d Not verified at index %d.\n", seed, cnt, val); return;}
+		}
+	}
+
+	// descending saw
+
+	for (cnt = 0 ; cnt < max ; cnt++)
+	{
+		r_array[cnt] = (max - cnt + 1) % (max / 11);
+	}
+
+	for (cnt = 1 ; cnt < max ; cnt += 7)
+	{
+		memcpy(a_array, r_array, cnt * sizeof(int));
+		memcpy(v_array, r_array, cnt * sizeof(int));
+
+		quadsort(a_array, cnt, sizeof(int), cmp_int);
+		qsort(v_array, cnt, sizeof(int), cmp_int);
+
+		for (val = 0 ; val < cnt ; val++)
+		{
+			if (val && v_array[val - 1] > v_array[val]) {printf("\e[1;31mvalidate descending saw: seed %d: size: %d Not properly sorted at index %d.\n\n", seed, cnt, val); return;}
+			if (a_array[val] != v_array[val])           {printf("\e[1;31mvalidate descending saw: seed %d: size: %d Not verified at index %d.\n\n", seed, cnt, val); return;}
 		}
 	}
 
@@ -656,19 +1694,45 @@ void validate()
 			if (a_array[val] != v_array[val])           {printf("\e[1;31mvalidate rand tail: seed %d: size: %d Not verified at index %d.\n", seed, cnt, val); return;}
 		}
 	}
+
+	// records, the bytes past the record hold a copy of its index, a cmp
+	// macro would compare them as numbers
+
+#ifndef cmp
+	records = (char *) malloc(max * 48);
+
+	for (size = 0 ; size < (int) (sizeof(sizes) / sizeof(int)) ; size++)
+	{
+		fill_records(records, max, sizes[size], 100);
+
+		quadsort(records, max, sizes[size], cmp_record);
+
+		val = check_records(records, max, sizes[size]);
+
+		if (val != -1) {printf("\e[1;31mvalidate records: seed %d: size: %d Not verified at index %d.\n", seed, sizes[size], val); return;}
+	}
+	free(records);
+#endif
 	free(a_array);
 	free(r_array);
 	free(v_array);
-}
 
-unsigned int bit_reverse(unsigned int x)
-{
-    x = (((x & 0xaaaaaaaa) >> 1) | ((x & 0x55555555) << 1));
-    x = (((x & 0xcccccccc) >> 2) | ((x & 0x33333333) << 2));
-    x = (((x & 0xf0f0f0f0) >> 4) | ((x & 0x0f0f0f0f) << 4));
-    x = (((x & 0xff00ff00) >> 8) | ((x & 0x00ff00ff) << 8));
+	validate_kv(seed);
+	validate_argsort(seed);
+#ifndef cmp
+	validate_merge_k(seed);
+	validate_partial(seed);
+	validate_select(seed);
+	validate_append(seed);
+	validate_natural(seed);
+#endif
 
-    return((x >> 16) | (x << 15));
+#ifdef QUADSORT_MT
+	validate_mt(seed);
+#endif
+#ifdef QUADSORT_EXT_H
+	validate_ext(seed);
+#endif
 }
 
 void run_test(void *a_array, void *r_array, void *v_array, int minimum, int maximum, int samples, int repetitions, int copies, const char *desc, size_t size, CMPFUNC *cmpf)
@@ -773,55 +1837,11 @@ void range_test(int max, int samples, int repetitions, int seed)
 	return;
 }
 
-#define VAR int
+// C strings and pointers to long double, long long and int, on random data
 
-int main(int argc, char **argv)
+void run_pointers(int max, int mem, int samples, int repetitions, int seed)
 {
-	int max = 100000;
-	int samples = 10;
-	int repetitions = 1;
-	int seed = 0;
-	int cnt, mem;
-	VAR *a_array, *r_array, *v_array, sum;
-
-	if (argc >= 1 && argv[1] && *argv[1])
-	{
-		max = atoi(argv[1]);
-	}
-
-	if (argc >= 2 && argv[2] && *argv[2])
-	{
-		samples = atoi(argv[2]);
-	}
-
-	if (argc >= 3 && argv[3] && *argv[3])
-	{
-		repetitions = atoi(argv[3]);
-	}
-
-	if (argc >= 4 && argv[4] && *argv[4])
-	{
-		seed = atoi(argv[4]);
-	}
-
-	validate();
-
-	seed = seed ? seed : time(NULL);
-
-	printf("Info: int = %lu, long long = %lu, long double = %lu\n\n", sizeof(int) * 8, sizeof(long long) * 8, sizeof(long double) * 8);
-
-	printf("Benchmark: array size: %d, samples: %d, repetitions: %d, seed: %d\n\n", max, samples, repetitions, seed);
-
-	if (repetitions == 0)
-	{
-		range_test(max, samples, repetitions, seed);
-		return 0;
-	}
-
-	mem = max * repetitions;
-
-#ifndef SKIP_STRINGS
-#ifndef cmp
+	int cnt;
 
 	// C string
 
@@ -860,9 +1880,9 @@ int main(int argc, char **argv)
 
 		if (da_array == NULL || dr_array == NULL || dv_array == NULL)
 		{
-			printf("main(%d,%d,%d): malloc: %s\n", max, samples, repetitions, strerror(errno));
+			printf("run_pointers(%d,%d,%d): malloc: %s\n", max, samples, repetitions, strerror(errno));
 
-			return 0;
+			return;
 		}
 
 		seed_rand(seed);
@@ -894,9 +1914,9 @@ int main(int argc, char **argv)
 
 		if (la_array == NULL || lr_array == NULL || lv_array == NULL)
 		{
-			printf("main(%d,%d,%d): malloc: %s\n", max, samples, repetitions, strerror(errno));
+			printf("run_pointers(%d,%d,%d): malloc: %s\n", max, samples, repetitions, strerror(errno));
 
-			return 0;
+			return;
 		}
 
 		seed_rand(seed);
@@ -929,9 +1949,9 @@ int main(int argc, char **argv)
 
 		if (la_array == NULL || lr_array == NULL || lv_array == NULL)
 		{
-			printf("main(%d,%d,%d): malloc: %s\n", max, samples, repetitions, strerror(errno));
+			printf("run_pointers(%d,%d,%d): malloc: %s\n", max, samples, repetitions, strerror(errno));
 
-			return 0;
+			return;
 		}
 
 		seed_rand(seed);
@@ -950,240 +1970,296 @@ int main(int argc, char **argv)
 
 		free(buffer);
 
-		printf("\n");
-	}
-#endif
-#endif
-	// 128 bit
-
-#ifndef SKIP_DOUBLES
-	long double *da_array = (long double *) malloc(max * sizeof(long double));
-	long double *dr_array = (long double *) malloc(mem * sizeof(long double));
-	long double *dv_array = (long double *) malloc(max * sizeof(long double));
-
-	if (da_array == NULL || dr_array == NULL || dv_array == NULL)
-	{
-		printf("main(%d,%d,%d): malloc: %s\n", max, samples, repetitions, strerror(errno));
-
-		return 0;
+		if (format == FORMAT_TABLE)
+		{
+			printf("\n");
+		}
 	}
+}
 
-	seed_rand(seed);
+// element types that can be chosen with --type, the 64 and 128 bit types
+// use 64 bit random keys
 
-	for (cnt = 0 ; cnt < mem ; cnt++)
-	{
-		dr_array[cnt] = (long double) rand();
-		dr_array[cnt] += (long double) ((unsigned long long) rand() << 32ULL);
-		dr_array[cnt] += 1.0L / 3.0L;
-	}
+typedef struct
+{
+	const char *name;
+	size_t size;
+	CMPFUNC *cmpf;
+	int wide;
+} TYPE;
 
-	memcpy(dv_array, dr_array, max * sizeof(long double));
-	quadsort(dv_array, max, sizeof(long double), cmp_long_double);
+const TYPE types[] =
+{
+	{ "int",    sizeof(int),         cmp_int,         0 },
+	{ "long",   sizeof(long long),   cmp_long,        1 },
+	{ "double", sizeof(long double), cmp_long_double, 1 }
+};
 
-	for (cnt = 0 ; (size_t) cnt < sizeof(sorts) / sizeof(char *) ; cnt++)
-	{
-		test_sort(da_array, dr_array, dv_array, max, max, samples, repetitions, qsort, sorts[cnt], "random order", sizeof(long double), cmp_long_double);
-	}
-#ifndef cmp
-#ifdef QUADSORT_H
-	test_sort(da_array, dr_array, dv_array, max, max, samples, repetitions, qsort, "s_quadsort", "random order", sizeof(long double), cmp_long_double_ptr);
-#endif
-#endif
-	free(da_array);
-	free(dr_array);
-	free(dv_array);
+#define TYPE_INT    0
+#define TYPE_LONG   1
+#define TYPE_DOUBLE 2
 
-	printf("\n");
-#endif
-	// 64 bit
+#define MAX_DISTS 64
 
-#ifndef SKIP_LONGS
-	long long *la_array = (long long *) malloc(max * sizeof(long long));
-	long long *lr_array = (long long *) malloc(mem * sizeof(long long));
-	long long *lv_array = (long long *) malloc(max * sizeof(long long));
+// benchmarks one element type on each of the chosen distributions
 
-	if (la_array == NULL || lr_array == NULL || lv_array == NULL)
+void run_type(int type, int *dist, int *param, int dist_cnt, int max, int mem, int samples, int repetitions, int seed)
+{
+	size_t size = types[type].size;
+	char *a_array = (char *) malloc(max * size);
+	char *r_array = (char *) malloc(mem * size);
+	char *v_array = (char *) malloc(max * size);
+	long long *keys = (long long *) malloc(mem * sizeof(long long));
+	char desc[40];
+	int cnt, end, index;
+
+	if (a_array == NULL || r_array == NULL || v_array == NULL || keys == NULL)
 	{
-		printf("main(%d,%d,%d): malloc: %s\n", max, samples, repetitions, strerror(errno));
+		printf("run_type(%d,%d,%d): malloc: %s\n", max, samples, repetitions, strerror(errno));
 
-		return 0;
+		free(a_array);
+		free(r_array);
+		free(v_array);
+		free(keys);
+		return;
 	}
 
 	seed_rand(seed);
 
-	for (cnt = 0 ; cnt < mem ; cnt++)
-	{
-		lr_array[cnt] = rand();
-		lr_array[cnt] += (unsigned long long) rand() << 32ULL;
-	}
-
-	memcpy(lv_array, lr_array, max * sizeof(long long));
-	quadsort(lv_array, max, sizeof(long long), cmp_long);
+	new_table = 1;
 
-	for (cnt = 0 ; (size_t) cnt < sizeof(sorts) / sizeof(char *) ; cnt++)
+	for (index = 0 ; index < dist_cnt ; index++)
 	{
-		test_sort(la_array, lr_array, lv_array, max, max, samples, repetitions, qsort, sorts[cnt], "random order", sizeof(long long), cmp_long);
-	}
-
-	free(la_array);
-	free(lr_array);
-	free(lv_array);
-
-	printf("\n");
-#endif
-	// 32 bit
-
-	a_array = (VAR *) malloc(max * sizeof(VAR));
-	r_array = (VAR *) malloc(mem * sizeof(VAR));
-	v_array = (VAR *) malloc(max * sizeof(VAR));
+		dists[dist[index]].func(keys, max, mem, types[type].wide, param[index]);
 
-	int quad0 = 0;
-	int nmemb = max;
-	int half1 = nmemb / 2;
-	int half2 = nmemb - half1;
-	int quad1 = half1 / 2;
-	int quad2 = half1 - quad1;
-	int quad3 = half2 / 2;
-	int quad4 = half2 - quad3;
+		end = dists[dist[index]].copies ? max : mem;
 
-	int span3 = quad1 + quad2 + quad3;
-
-	// random
+		for (cnt = 0 ; cnt < end ; cnt++)
+		{
+			switch (type)
+			{
+				case TYPE_INT:    ((int *) r_array)[cnt] = (int) keys[cnt]; break;
+				case TYPE_LONG:   ((long long *) r_array)[cnt] = keys[cnt]; break;
+				case TYPE_DOUBLE: ((long double *) r_array)[cnt] = (long double) keys[cnt] + 1.0L / 3.0L; break;
+			}
+		}
+		dist_desc(desc, dist[index], param[index]);
 
-	seed_rand(seed);
+		run_test(a_array, r_array, v_array, max, max, samples, repetitions, dists[dist[index]].copies ? repetitions : 0, desc, size, types[type].cmpf);
 
-	for (cnt = 0 ; cnt < mem ; cnt++)
-	{
-		r_array[cnt] = rand();
+#ifndef cmp
+#ifdef QUADSORT_H
+		if (type == TYPE_DOUBLE && dist[index] == 0)
+		{
+			test_sort(a_array, r_array, v_array, max, max, samples, repetitions, qsort, "s_quadsort", desc, size, cmp_long_double_ptr);
+		}
+#endif
+#endif
 	}
-	run_test(a_array, r_array, v_array, max, max, samples, repetitions, 0, "random order", sizeof(VAR), cmp_int);
+	free(a_array);
+	free(r_array);
+	free(v_array);
+	free(keys);
+}
 
-	// random % 100
+void usage(const char *name)
+{
+	int cnt;
 
-	for (cnt = 0 ; cnt < mem ; cnt++)
-	{
-		r_array[cnt] = rand() % 100;
-	}
-	run_test(a_array, r_array, v_array, max, max, samples, repetitions, 0, "random % 100", sizeof(VAR), cmp_int);
+	printf("usage: %s [--format=table|json|csv] [--perf] [--dist=name[:param],...] [--type=int,long,double] [max] [samples] [repetitions] [seed]\n\n", name);
 
-	// ascending
+	printf("distributions:");
 
-	for (cnt = sum = 0 ; cnt < mem ; cnt++)
+	for (cnt = 0 ; (size_t) cnt < sizeof(dists) / sizeof(DIST) ; cnt++)
 	{
-		r_array[cnt] = sum; sum += rand() % 5;
+		if (dists[cnt].param)
+		{
+			printf(" %s:%d", dists[cnt].name, dists[cnt].param);
+		}
+		else
+		{
+			printf(" %s", dists[cnt].name);
+		}
 	}
+	printf("\n");
+}
 
-	run_test(a_array, r_array, v_array, max, max, samples, repetitions, 0, "ascending order", sizeof(VAR), cmp_int);
+#define VAR int
 
-	// ascending saw
+int main(int argc, char **argv)
+{
+	int max = 100000;
+	int samples = 10;
+	int repetitions = 1;
+	int seed = 0;
+	int cnt, mem, arg, index;
+	VAR *a_array, *r_array, *v_array;
+	int dist[MAX_DISTS], param[MAX_DISTS], dist_cnt = 0;
+	int type[MAX_DISTS], type_cnt = 0;
+	char *name;
 
-	for (cnt = 0 ; cnt < max ; cnt++)
-	{
-		r_array[cnt] = rand();
-	}
+	// options start with --, the other arguments are max, samples,
+	// repetitions and seed in that order
 
-	quadsort(r_array + quad0, quad1, sizeof(VAR), cmp_int);
-	quadsort(r_array + quad1, quad2, sizeof(VAR), cmp_int);
-	quadsort(r_array + half1, quad3, sizeof(VAR), cmp_int);
-	quadsort(r_array + span3, quad4, sizeof(VAR), cmp_int);
+	for (cnt = 1, arg = 0 ; cnt < argc ; cnt++)
+	{
+		if (!strncmp(argv[cnt], "--", 2))
+		{
+			if (!strcmp(argv[cnt], "--format=json"))
+			{
+				format = FORMAT_JSON;
+			}
+			else if (!strcmp(argv[cnt], "--format=csv"))
+			{
+				format = FORMAT_CSV;
+			}
+			else if (!strcmp(argv[cnt], "--format=table"))
+			{
+				format = FORMAT_TABLE;
+			}
+			else if (!strcmp(argv[cnt], "--perf"))
+			{
+				perf = 1;
+			}
+			else if (!strncmp(argv[cnt], "--dist=", 7))
+			{
+				for (name = strtok(argv[cnt] + 7, ",") ; name ; name = strtok(NULL, ","))
+				{
+					if (dist_cnt == MAX_DISTS || (dist[dist_cnt] = dist_find(name, &param[dist_cnt])) == -1)
+					{
+						printf("unknown distribution: %s\n\n", name);
+						usage(argv[0]);
 
-	run_test(a_array, r_array, v_array, max, max, samples, repetitions, repetitions, "ascending saw", sizeof(VAR), cmp_int);
+						return 1;
+					}
+					dist_cnt++;
+				}
+			}
+			else if (!strncmp(argv[cnt], "--type=", 7))
+			{
+				for (name = strtok(argv[cnt] + 7, ",") ; name ; name = strtok(NULL, ","))
+				{
+					for (index = 0 ; (size_t) index < sizeof(types) / sizeof(TYPE) ; index++)
+					{
+						if (!strcmp(types[index].name, name))
+						{
+							break;
+						}
+					}
 
-	// pipe organ
+					if (type_cnt == MAX_DISTS || (size_t) index == sizeof(types) / sizeof(TYPE))
+					{
+						printf("unknown type: %s\n\n", name);
+						usage(argv[0]);
 
-	for (cnt = 0 ; cnt < max ; cnt++)
-	{
-		r_array[cnt] = rand();
-	}
+						return 1;
+					}
+					type[type_cnt++] = index;
+				}
+			}
+			else
+			{
+				usage(argv[0]);
 
-	quadsort(r_array + quad0, half1, sizeof(VAR), cmp_int);
-	qsort(r_array + half1, half2, sizeof(VAR), cmp_rev);
+				return 1;
+			}
+			continue;
+		}
 
-	for (cnt = half1 + 1 ; cnt < max ; cnt++)
-	{
-		if (r_array[cnt] >= r_array[cnt - 1])
+		if (*argv[cnt])
 		{
-			r_array[cnt] = r_array[cnt - 1] - 1; // guarantee the run is strictly descending
+			switch (arg)
+			{
+				case 0: max = atoi(argv[cnt]); break;
+				case 1: samples = atoi(argv[cnt]); break;
+				case 2: repetitions = atoi(argv[cnt]); break;
+				case 3: seed = atoi(argv[cnt]); break;
+			}
 		}
+		arg++;
 	}
 
-	run_test(a_array, r_array, v_array, max, max, samples, repetitions, repetitions, "pipe organ", sizeof(VAR), cmp_int);
-
-	// descending
-
-	for (cnt = 0, sum = mem * 10 ; cnt < mem ; cnt++)
+	if (perf)
 	{
-		r_array[cnt] = sum; sum -= 1 + rand() % 5;
+		perf_open();
 	}
-	run_test(a_array, r_array, v_array, max, max, samples, repetitions, 0, "descending order", sizeof(VAR), cmp_int);
-
-	// descending saw
 
-	for (cnt = 0 ; cnt < max ; cnt++)
-	{
-		r_array[cnt] = rand();
-	}
+	validate();
 
-	qsort(r_array + quad0, quad1, sizeof(VAR), cmp_rev);
-	qsort(r_array + quad1, quad2, sizeof(VAR), cmp_rev);
-	qsort(r_array + half1, quad3, sizeof(VAR), cmp_rev);
-	qsort(r_array + span3, quad4, sizeof(VAR), cmp_rev);
+	seed = seed ? seed : time(NULL);
 
-	for (cnt = 1 ; cnt < max ; cnt++)
+	if (format == FORMAT_TABLE)
 	{
-		if (cnt == quad1 || cnt == half1 || cnt == span3) continue;
+		printf("Info: int = %lu, long long = %lu, long double = %lu\n\n", sizeof(int) * 8, sizeof(long long) * 8, sizeof(long double) * 8);
 
-		if (r_array[cnt] >= r_array[cnt - 1])
-		{
-			r_array[cnt] = r_array[cnt - 1] - 1; // guarantee the run is strictly descending
-		}
+		printf("Benchmark: array size: %d, samples: %d, repetitions: %d, seed: %d\n\n", max, samples, repetitions, seed);
 	}
 
-	run_test(a_array, r_array, v_array, max, max, samples, repetitions, repetitions, "descending saw", sizeof(VAR), cmp_int);
-
-
-	// random tail 25%
-
-	for (cnt = 0 ; cnt < max ; cnt++)
+	if (repetitions == 0)
 	{
-		r_array[cnt] = rand();
+		range_test(max, samples, repetitions, seed);
+		return 0;
 	}
-	quadsort(r_array, span3, sizeof(VAR), cmp_int);
 
-	run_test(a_array, r_array, v_array, max, max, samples, repetitions, repetitions, "random tail", sizeof(VAR), cmp_int);
+	mem = max * repetitions;
 
-	// random 50%
+	// without --dist or --type the pointer tables are benchmarked, followed
+	// by random order for the 128 and 64 bit types, and the default
+	// distributions for the 32 bit type
 
-	for (cnt = 0 ; cnt < max ; cnt++)
+	if (dist_cnt == 0 && type_cnt == 0)
 	{
-		r_array[cnt] = rand();
-	}
-	quadsort(r_array, half1, sizeof(VAR), cmp_int);
+#ifndef SKIP_STRINGS
+#ifndef cmp
+		run_pointers(max, mem, samples, repetitions, seed);
+#endif
+#endif
+		dist[0] = param[0] = 0;
 
-	run_test(a_array, r_array, v_array, max, max, samples, repetitions, repetitions, "random half", sizeof(VAR), cmp_int);
+#ifndef SKIP_DOUBLES
+		run_type(TYPE_DOUBLE, dist, param, 1, max, mem, samples, repetitions, seed);
 
-	// tiles
+		if (format == FORMAT_TABLE)
+		{
+			printf("\n");
+		}
+#endif
+#ifndef SKIP_LONGS
+		run_type(TYPE_LONG, dist, param, 1, max, mem, samples, repetitions, seed);
 
-	for (cnt = 0 ; cnt < mem ; cnt++)
-	{
-		if (cnt % 2 == 0)
+		if (format == FORMAT_TABLE)
 		{
-			r_array[cnt] = 16777216 + cnt;
+			printf("\n");
 		}
-		else
+#endif
+	}
+
+	if (dist_cnt == 0)
+	{
+		for (dist_cnt = 0 ; dist_cnt < dist_defaults ; dist_cnt++)
 		{
-			r_array[cnt] = 33554432 + cnt;
+			dist[dist_cnt] = dist_cnt;
+			param[dist_cnt] = dists[dist_cnt].param;
 		}
 	}
-	run_test(a_array, r_array, v_array, max, max, samples, repetitions, 0, "ascending tiles", sizeof(VAR), cmp_int);
 
-	// bit-reversal
+	if (type_cnt == 0)
+	{
+		type[type_cnt++] = TYPE_INT;
+	}
 
-	for (cnt = 0 ; cnt < mem ; cnt++)
+	for (index = 0 ; index < type_cnt ; index++)
 	{
-		r_array[cnt] = bit_reverse(cnt);
+		if (index && format == FORMAT_TABLE)
+		{
+			printf("\n");
+		}
+		run_type(type[index], dist, param, dist_cnt, max, mem, samples, repetitions, seed);
 	}
-	run_test(a_array, r_array, v_array, max, max, samples, repetitions, 0, "bit reversal", sizeof(VAR), cmp_int);
+
+	a_array = (VAR *) malloc(max * sizeof(VAR));
+	r_array = (VAR *) malloc(mem * sizeof(VAR));
+	v_array = (VAR *) malloc(max * sizeof(VAR));
 
 #ifndef cmp
   #ifdef ANTIQSORT
@@ -1200,5 +2276,9 @@ int main(int argc, char **argv)
 	free(r_array);
 	free(v_array);
 
+	if (perf)
+	{
+		perf_close();
+	}
 	return 0;
 }
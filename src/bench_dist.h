@@ -0,0 +1,343 @@
+// bench_dist 1.0 - Key distributions for bench.c
+
+#ifndef BENCH_DIST_H
+#define BENCH_DIST_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Each generator fills an array of 64 bit keys, which bench.c converts to
+// the element type that is benchmarked. When wide is set the random keys use
+// 64 bits, otherwise the 31 bits of rand(). Generators with copies set only
+// fill the first max keys, which the benchmark then copies for each
+// repetition, the others fill all mem keys.
+
+typedef void DISTFUNC(long long *array, int max, int mem, int wide, int param);
+
+typedef struct
+{
+	const char *name;
+	DISTFUNC *func;
+	int copies;
+	int param;
+	const char *desc;
+} DIST;
+
+int dist_cmp(const void *a, const void *b)
+{
+	const long long fa = *(const long long *) a;
+	const long long fb = *(const long long *) b;
+
+	return (fa > fb) - (fa < fb);
+}
+
+int dist_rev(const void *a, const void *b)
+{
+	return dist_cmp(b, a);
+}
+
+long long dist_rand(int wide)
+{
+	long long key = rand();
+
+	if (wide)
+	{
+		key += (unsigned long long) rand() << 32ULL;
+	}
+	return key;
+}
+
+void dist_fill(long long *array, int nmemb, int wide)
+{
+	int cnt;
+
+	for (cnt = 0 ; cnt < nmemb ; cnt++)
+	{
+		array[cnt] = dist_rand(wide);
+	}
+}
+
+// keeps a reverse sorted run strictly descending, so it's reversed by the sort
+
+void dist_descend(long long *array, int nmemb)
+{
+	int cnt;
+
+	for (cnt = 1 ; cnt < nmemb ; cnt++)
+	{
+		if (array[cnt] >= array[cnt - 1])
+		{
+			array[cnt] = array[cnt - 1] - 1;
+		}
+	}
+}
+
+unsigned int bit_reverse(unsigned int x)
+{
+    x = (((x & 0xaaaaaaaa) >> 1) | ((x & 0x55555555) << 1));
+    x = (((x & 0xcccccccc) >> 2) | ((x & 0x33333333) << 2));
+    x = (((x & 0xf0f0f0f0) >> 4) | ((x & 0x0f0f0f0f) << 4));
+    x = (((x & 0xff00ff00) >> 8) | ((x & 0x00ff00ff) << 8));
+
+    return((x >> 16) | (x << 15));
+}
+
+void dist_random(long long *array, int max, int mem, int wide, int param)
+{
+	dist_fill(array, mem, wide);
+}
+
+void dist_modulo(long long *array, int max, int mem, int wide, int param)
+{
+	int cnt;
+
+	for (cnt = 0 ; cnt < mem ; cnt++)
+	{
+		array[cnt] = rand() % param;
+	}
+}
+
+void dist_ascending(long long *array, int max, int mem, int wide, int param)
+{
+	long long sum = 0;
+	int cnt;
+
+	for (cnt = 0 ; cnt < mem ; cnt++)
+	{
+		array[cnt] = sum; sum += rand() % 5;
+	}
+}
+
+void dist_ascending_saw(long long *array, int max, int mem, int wide, int param)
+{
+	int half1 = max / 2, quad1 = half1 / 2, quad2 = half1 - quad1, quad3 = (max - half1) / 2;
+
+	dist_fill(array, max, wide);
+
+	qsort(array, quad1, sizeof(long long), dist_cmp);
+	qsort(array + quad1, quad2, sizeof(long long), dist_cmp);
+	qsort(array + half1, quad3, sizeof(long long), dist_cmp);
+	qsort(array + half1 + quad3, max - half1 - quad3, sizeof(long long), dist_cmp);
+}
+
+void dist_pipe_organ(long long *array, int max, int mem, int wide, int param)
+{
+	int half1 = max / 2;
+
+	dist_fill(array, max, wide);
+
+	qsort(array, half1, sizeof(long long), dist_cmp);
+	qsort(array + half1, max - half1, sizeof(long long), dist_rev);
+
+	if (half1 < max)
+	{
+		dist_descend(array + half1, max - half1);
+	}
+}
+
+void dist_descending(long long *array, int max, int mem, int wide, int param)
+{
+	long long sum = mem * 10;
+	int cnt;
+
+	for (cnt = 0 ; cnt < mem ; cnt++)
+	{
+		array[cnt] = sum; sum -= 1 + rand() % 5;
+	}
+}
+
+void dist_descending_saw(long long *array, int max, int mem, int wide, int param)
+{
+	int half1 = max / 2, quad1 = half1 / 2, quad2 = half1 - quad1, quad3 = (max - half1) / 2;
+
+	dist_fill(array, max, wide);
+
+	qsort(array, quad1, sizeof(long long), dist_rev);
+	qsort(array + quad1, quad2, sizeof(long long), dist_rev);
+	qsort(array + half1, quad3, sizeof(long long), dist_rev);
+	qsort(array + half1 + quad3, max - half1 - quad3, sizeof(long long), dist_rev);
+
+	dist_descend(array, quad1);
+	dist_descend(array + quad1, quad2);
+	dist_descend(array + half1, quad3);
+	dist_descend(array + half1 + quad3, max - half1 - quad3);
+}
+
+// param is the percentage of the array that is left in random order
+
+void dist_random_tail(long long *array, int max, int mem, int wide, int param)
+{
+	dist_fill(array, max, wide);
+
+	qsort(array, (long long) max * (100 - param) / 100, sizeof(long long), dist_cmp);
+}
+
+void dist_tiles(long long *array, int max, int mem, int wide, int param)
+{
+	int cnt;
+
+	for (cnt = 0 ; cnt < mem ; cnt++)
+	{
+		array[cnt] = (cnt % 2 == 0 ? 16777216 : 33554432) + cnt;
+	}
+}
+
+void dist_bit_reversal(long long *array, int max, int mem, int wide, int param)
+{
+	int cnt;
+
+	for (cnt = 0 ; cnt < mem ; cnt++)
+	{
+		array[cnt] = (int) bit_reverse(cnt);
+	}
+}
+
+// key k is drawn with a probability of 1 / k, from param keys or max keys
+// when param is 0, found with a binary search of the cumulative weights
+
+void dist_zipf(long long *array, int max, int mem, int wide, int param)
+{
+	int keys = param ? param : max > 0 ? max : 1;
+	double *weight = (double *) malloc(keys * sizeof(double));
+	double sum, pick;
+	int cnt, bot, mid;
+
+	for (cnt = 0, sum = 0 ; cnt < keys ; cnt++)
+	{
+		sum += 1.0 / (cnt + 1);
+		weight[cnt] = sum;
+	}
+
+	for (cnt = 0 ; cnt < mem ; cnt++)
+	{
+		pick = (double) rand() / ((double) RAND_MAX + 1) * sum;
+
+		for (bot = 0, mid = keys ; mid > 1 ; mid -= mid / 2)
+		{
+			if (weight[bot + mid / 2 - 1] <= pick)
+			{
+				bot += mid / 2;
+			}
+		}
+		array[cnt] = bot + 1;
+	}
+	free(weight);
+}
+
+void dist_few_unique(long long *array, int max, int mem, int wide, int param)
+{
+	long long *keys = (long long *) malloc(param * sizeof(long long));
+	int cnt;
+
+	dist_fill(keys, param, wide);
+
+	for (cnt = 0 ; cnt < mem ; cnt++)
+	{
+		array[cnt] = keys[rand() % param];
+	}
+	free(keys);
+}
+
+// ascending order with param percent of the keys swapped at random
+
+void dist_sorted_swaps(long long *array, int max, int mem, int wide, int param)
+{
+	long long swap;
+	int cnt, x, y;
+
+	for (cnt = 0 ; cnt < max ; cnt++)
+	{
+		array[cnt] = cnt;
+	}
+
+	for (cnt = (long long) max * param / 200 ; cnt > 0 ; cnt--)
+	{
+		x = rand() % max;
+		y = rand() % max;
+
+		swap = array[x]; array[x] = array[y]; array[y] = swap;
+	}
+}
+
+void dist_sorted_runs(long long *array, int max, int mem, int wide, int param)
+{
+	int cnt;
+
+	dist_fill(array, max, wide);
+
+	for (cnt = 0 ; cnt < max ; cnt += param)
+	{
+		qsort(array + cnt, cnt + param <= max ? param : max - cnt, sizeof(long long), dist_cmp);
+	}
+}
+
+// increasing timestamps in microseconds, each delayed by up to param
+
+void dist_timestamps(long long *array, int max, int mem, int wide, int param)
+{
+	long long stamp = wide ? 1700000000000000LL : 0;
+	int cnt;
+
+	for (cnt = 0 ; cnt < mem ; cnt++)
+	{
+		stamp += rand() % 4;
+
+		array[cnt] = stamp + rand() % param;
+	}
+}
+
+// the first dist_defaults distributions are benchmarked when none is chosen
+
+const DIST dists[] =
+{
+	{ "random",          dist_random,         0,    0, "random order" },
+	{ "random-100",      dist_modulo,         0,  100, "random %% %d" },
+	{ "ascending",       dist_ascending,      0,    0, "ascending order" },
+	{ "ascending-saw",   dist_ascending_saw,  1,    0, "ascending saw" },
+	{ "pipe-organ",      dist_pipe_organ,     1,    0, "pipe organ" },
+	{ "descending",      dist_descending,     0,    0, "descending order" },
+	{ "descending-saw",  dist_descending_saw, 1,    0, "descending saw" },
+	{ "random-tail",     dist_random_tail,    1,   25, "random tail" },
+	{ "random-half",     dist_random_tail,    1,   50, "random half" },
+	{ "ascending-tiles", dist_tiles,          0,    0, "ascending tiles" },
+	{ "bit-reversal",    dist_bit_reversal,   0,    0, "bit reversal" },
+	{ "zipf",            dist_zipf,           0,    0, "zipf" },
+	{ "few-unique",      dist_few_unique,     0,    8, "few unique %d" },
+	{ "sorted-swaps",    dist_sorted_swaps,   1,    1, "sorted swaps %d%%" },
+	{ "sorted-runs",     dist_sorted_runs,    1, 1000, "sorted runs %d" },
+	{ "timestamps",      dist_timestamps,     0,   64, "timestamps %d" }
+};
+
+const int dist_defaults = 11;
+
+// returns the index of name, which may be followed by :param, or -1
+
+int dist_find(const char *name, int *param)
+{
+	const char *colon = strchr(name, ':');
+	size_t length = colon ? (size_t) (colon - name) : strlen(name);
+	int cnt;
+
+	for (cnt = 0 ; (size_t) cnt < sizeof(dists) / sizeof(DIST) ; cnt++)
+	{
+		if (strlen(dists[cnt].name) == length && !strncmp(dists[cnt].name, name, length))
+		{
+			*param = colon ? atoi(colon + 1) : dists[cnt].param;
+
+			if (colon && *param <= 0)
+			{
+				return -1;
+			}
+			return cnt;
+		}
+	}
+	return -1;
+}
+
+void dist_desc(char *desc, int index, int param)
+{
+	sprintf(desc, dists[index].desc, param);
+}
+
+#endif
@@ -1,5 +1,16 @@
 // quadsort 1.2.1.3 - Igor van den Hoven ivdhoven@gmail.com
 
+// with QUADSORT_STATS the comparison function calls and memcpy calls are
+// counted, cmp is a function pointer unless a cmp() macro was defined
+
+#ifdef QUADSORT_STATS
+  #ifndef cmp
+    #define QUAD_STATS_CMP
+    #define cmp(a,b) QUAD_COUNT(cmp(a, b))
+  #endif
+  #define memcpy(dest, src, size) quad_stats_memcpy(dest, src, size)
+#endif
+
 // the next seven functions are used for sorting 0 to 31 elements
 
 void FUNC(parity_swap_four)(VAR *array, CMPFUNC *cmp)
@@ -147,6 +158,9 @@ void FUNC(parity_merge)(VAR *dest, VAR *from, size_t left, size_t right, CMPFUNC
 	VAR *ptl, *ptr, *tpl, *tpr, *tpd, *ptd;
 #if !defined __clang__
 	size_t x, y;
+#endif
+#ifdef QUAD_SIMD
+	size_t cnt;
 #endif
 	ptl = from;
 	ptr = from + left;
@@ -155,13 +169,24 @@ void FUNC(parity_merge)(VAR *dest, VAR *from, size_t left, size_t right, CMPFUNC
 	tpr = tpl + right;
 	tpd = dest + left + right - 1;
 
+	QUAD_STAT(quadsort_stats.moves += left + right);
+
 	if (left < right)
 	{
 		*ptd++ = cmp(ptl, ptr) <= 0 ? *ptl++ : *ptr++;
 	}
 	*ptd++ = cmp(ptl, ptr) <= 0 ? *ptl++ : *ptr++;
 
-#if !defined cmp && !defined __clang__ // cache limit workaround for gcc
+#ifdef QUAD_SIMD
+	while (left > 8 && tpl - ptl >= 15 && tpr - ptr >= 15)
+	{
+		cnt = QUAD_SIMD(quad_head_merge)(ptd, ptl, ptr, QUAD_BIAS); ptd += 8; ptl += cnt; ptr += 8 - cnt;
+		cnt = QUAD_SIMD(quad_tail_merge)(tpd, tpl, tpr, QUAD_BIAS); tpd -= 8; tpl -= cnt; tpr -= 8 - cnt;
+
+		left -= 8;
+	}
+#endif
+#if (!defined cmp || defined QUAD_ARG || defined QUAD_STATS_CMP) && !defined __clang__ // cache limit workaround for gcc
 	if (left > QUAD_CACHE)
 	{
 		while (--left)
@@ -242,6 +267,9 @@ void FUNC(quad_reversal)(VAR *pta, VAR *ptz)
 
 void FUNC(quad_swap_merge)(VAR *array, VAR *swap, CMPFUNC *cmp)
 {
+#ifdef QUAD_SIMD
+	QUAD_SIMD(quad_swap_merge)(array, QUAD_BIAS);
+#else
 	VAR *pts, *ptl, *ptr;
 #if !defined __clang__
 	size_t x;
@@ -250,9 +278,12 @@ void FUNC(quad_swap_merge)(VAR *array, VAR *swap, CMPFUNC *cmp)
 	parity_merge_two(array + 4, swap + 4, x, ptl, ptr, pts, cmp);
 
 	parity_merge_four(swap, array, x, ptl, ptr, pts, cmp);
+#endif
 }
 
+#ifndef QUAD_CPP // members of quadsort.hpp's class template can't be declared twice
 void FUNC(tail_merge)(VAR *array, VAR *swap, size_t swap_size, size_t nmemb, size_t block, CMPFUNC *cmp);
+#endif
 
 size_t FUNC(quad_swap)(VAR *array, size_t nmemb, CMPFUNC *cmp)
 {
@@ -260,6 +291,7 @@ size_t FUNC(quad_swap)(VAR *array, size_t nmemb, CMPFUNC *cmp)
 	size_t count;
 	VAR *pta, *pts;
 	unsigned char v1, v2, v3, v4, x;
+	QUAD_STAT(unsigned long long start = quad_stats_clock());
 	pta = array;
 
 	count = nmemb / 8;
@@ -303,6 +335,8 @@ size_t FUNC(quad_swap)(VAR *array, size_t nmemb, CMPFUNC *cmp)
 
 		ordered:
 
+		QUAD_STAT(quadsort_stats.quad_swap_ordered++);
+
 		pta += 8;
 
 		if (count--)
@@ -328,6 +362,8 @@ size_t FUNC(quad_swap)(VAR *array, size_t nmemb, CMPFUNC *cmp)
 
 		reversed:
 
+		QUAD_STAT(quadsort_stats.quad_swap_reversed++);
+
 		pta += 8;
 
 		if (count--)
@@ -382,6 +418,8 @@ size_t FUNC(quad_swap)(VAR *array, size_t nmemb, CMPFUNC *cmp)
 
 				if (pts == array)
 				{
+					QUAD_STAT(quadsort_stats.quad_swap_cycles += quad_stats_clock() - start);
+
 					return 1;
 				}
 				goto reverse_end;
@@ -401,75 +439,182 @@ size_t FUNC(quad_swap)(VAR *array, size_t nmemb, CMPFUNC *cmp)
 		{
 			continue;
 		}
+#ifdef QUAD_SIMD
+		QUAD_SIMD(quad_merge_thirtytwo)(pta, QUAD_BIAS);
+#else
 		FUNC(parity_merge)(swap, pta, 8, 8, cmp);
 		FUNC(parity_merge)(swap + 16, pta + 16, 8, 8, cmp);
 		FUNC(parity_merge)(pta, swap, 16, 16, cmp);
+#endif
 	}
 
 	if (nmemb % 32 > 8)
 	{
 		FUNC(tail_merge)(pta, swap, 32, nmemb % 32, 8, cmp);
 	}
+	QUAD_STAT(quadsort_stats.quad_swap_cycles += quad_stats_clock() - start);
+
 	return 0;
 }
 
+// exponential search for the number of elements at the head or tail of a run
+// that go before or after key, used to gallop through skewed merges. The
+// merges count their skips in a row and gallop after QUAD_GALLOP of them.
+
+size_t FUNC(quad_gallop_head)(VAR *array, size_t nmemb, VAR *key, size_t right, CMPFUNC *cmp)
+{
+	size_t base = 0, step = 1, half;
+
+	while (base + step <= nmemb && (right ? cmp(key, array + base + step - 1) > 0 : cmp(array + base + step - 1, key) <= 0))
+	{
+		base += step; step *= 2;
+	}
+	step = base + step <= nmemb ? step - 1 : nmemb - base;
+
+	while (step)
+	{
+		half = step / 2;
+
+		if (right ? cmp(key, array + base + half) > 0 : cmp(array + base + half, key) <= 0)
+		{
+			base += half + 1; step -= half + 1;
+		}
+		else
+		{
+			step = half;
+		}
+	}
+	return base;
+}
+
+size_t FUNC(quad_gallop_tail)(VAR *array, size_t nmemb, VAR *key, size_t right, CMPFUNC *cmp)
+{
+	size_t base = 0, step = 1, half;
+
+	while (base + step <= nmemb && (right ? cmp(key, array - base - step + 1) <= 0 : cmp(array - base - step + 1, key) > 0))
+	{
+		base += step; step *= 2;
+	}
+	step = base + step <= nmemb ? step - 1 : nmemb - base;
+
+	while (step)
+	{
+		half = step / 2;
+
+		if (right ? cmp(key, array - base - half) <= 0 : cmp(array - base - half, key) > 0)
+		{
+			base += half + 1; step -= half + 1;
+		}
+		else
+		{
+			step = half;
+		}
+	}
+	return base;
+}
+
 // The next six functions are quad merge support routines
 
-void FUNC(cross_merge)(VAR *dest, VAR *from, size_t left, size_t right, CMPFUNC *cmp)
+// the left and right array don't need to be adjacent, which allows parallel
+// merges of independent segments
+
+void FUNC(cross_merge_split)(VAR *dest, VAR *ptl, size_t left, VAR *ptr, size_t right, CMPFUNC *cmp)
 {
-	VAR *ptl, *tpl, *ptr, *tpr, *ptd, *tpd;
-	size_t loop;
+	VAR *tpl, *tpr, *ptd, *tpd;
+	size_t loop, skips = 0;
 #if !defined __clang__
 	size_t x, y;
 #endif
-	ptl = from;
-	ptr = from + left;
-	tpl = ptr - 1;
-	tpr = tpl + right;
+	tpl = ptl + left - 1;
+	tpr = ptr + right - 1;
 
-	if (left + 1 >= right && right >= left && left >= 32)
+	if (left + 1 >= right && right >= left && left >= 32 && ptr == ptl + left)
 	{
 		if (cmp(ptl + 15, ptr) > 0 && cmp(ptl, ptr + 15) <= 0 && cmp(tpl, tpr - 15) > 0 && cmp(tpl - 15, tpr) <= 0)
 		{
-			FUNC(parity_merge)(dest, from, left, right, cmp);
+			FUNC(parity_merge)(dest, ptl, left, right, cmp);
 			return;
 		}
 	}
 	ptd = dest;
 	tpd = dest + left + right - 1;
 
+	QUAD_STAT(quadsort_stats.moves += left + right);
+
 	while (1)
 	{
 		if (tpl - ptl > 8)
 		{
+			skips = 0;
+
 			ptl8_ptr: if (cmp(ptl + 7, ptr) <= 0)
 			{
 				memcpy(ptd, ptl, 8 * sizeof(VAR)); ptd += 8; ptl += 8;
 
+				if (++skips == QUAD_GALLOP && tpl - ptl > 8)
+				{
+					loop = FUNC(quad_gallop_head)(ptl, tpl - ptl - 1, ptr, 0, cmp);
+
+					memcpy(ptd, ptl, loop * sizeof(VAR)); ptd += loop; ptl += loop;
+
+					skips = 0;
+
+					if (tpl - ptl > 8) {goto tpl8_tpr;} continue;
+				}
 				if (tpl - ptl > 8) {goto ptl8_ptr;} continue;
 			}
+			skips = 0;
 
 			tpl8_tpr: if (cmp(tpl - 7, tpr) > 0)
 			{
 				tpd -= 7; tpl -= 7; memcpy(tpd--, tpl--, 8 * sizeof(VAR));
 
+				if (++skips == QUAD_GALLOP && tpl - ptl > 8)
+				{
+					loop = FUNC(quad_gallop_tail)(tpl, tpl - ptl - 1, tpr, 0, cmp);
+
+					tpd -= loop; tpl -= loop; memcpy(tpd + 1, tpl + 1, loop * sizeof(VAR));
+
+					continue;
+				}
 				if (tpl - ptl > 8) {goto tpl8_tpr;} continue;
 			}
 		}
 
 		if (tpr - ptr > 8)
 		{
+			skips = 0;
+
 			ptl_ptr8: if (cmp(ptl, ptr + 7) > 0)
 			{
 				memcpy(ptd, ptr, 8 * sizeof(VAR)); ptd += 8; ptr += 8;
 
+				if (++skips == QUAD_GALLOP && tpr - ptr > 8)
+				{
+					loop = FUNC(quad_gallop_head)(ptr, tpr - ptr - 1, ptl, 1, cmp);
+
+					memcpy(ptd, ptr, loop * sizeof(VAR)); ptd += loop; ptr += loop;
+
+					skips = 0;
+
+					if (tpr - ptr > 8) {goto tpl_tpr8;} continue;
+				}
 				if (tpr - ptr > 8) {goto ptl_ptr8;} continue;
 			}
+			skips = 0;
 
 			tpl_tpr8: if (cmp(tpl, tpr - 7) <= 0)
 			{
 				tpd -= 7; tpr -= 7; memcpy(tpd--, tpr--, 8 * sizeof(VAR));
 
+				if (++skips == QUAD_GALLOP && tpr - ptr > 8)
+				{
+					loop = FUNC(quad_gallop_tail)(tpr, tpr - ptr - 1, tpl, 1, cmp);
+
+					tpd -= loop; tpr -= loop; memcpy(tpd + 1, tpr + 1, loop * sizeof(VAR));
+
+					continue;
+				}
 				if (tpr - ptr > 8) {goto tpl_tpr8;} continue;
 			}
 		}
@@ -479,7 +624,17 @@ void FUNC(cross_merge)(VAR *dest, VAR *from, size_t left, size_t right, CMPFUNC
 			break;
 		}
 
-#if !defined cmp && !defined __clang__
+#ifdef QUAD_SIMD
+		if (tpl - ptl >= 15 && tpr - ptr >= 15)
+		{
+			loop = QUAD_SIMD(quad_head_merge)(ptd, ptl, ptr, QUAD_BIAS); ptd += 8; ptl += loop; ptr += 8 - loop;
+			loop = QUAD_SIMD(quad_tail_merge)(tpd, tpl, tpr, QUAD_BIAS); tpd -= 8; tpl -= loop; tpr -= 8 - loop;
+
+			continue;
+		}
+#endif
+
+#if (!defined cmp || defined QUAD_ARG || defined QUAD_STATS_CMP) && !defined __clang__
 		if (left > QUAD_CACHE)
 		{
 			loop = 8; do
@@ -515,6 +670,11 @@ void FUNC(cross_merge)(VAR *dest, VAR *from, size_t left, size_t right, CMPFUNC
 	}
 }
 
+void FUNC(cross_merge)(VAR *dest, VAR *from, size_t left, size_t right, CMPFUNC *cmp)
+{
+	FUNC(cross_merge_split)(dest, from, left, from + left, right, cmp);
+}
+
 void FUNC(quad_merge_block)(VAR *array, VAR *swap, size_t block, CMPFUNC *cmp)
 {
 	VAR *pt1, *pt2, *pt3;
@@ -527,18 +687,22 @@ void FUNC(quad_merge_block)(VAR *array, VAR *swap, size_t block, CMPFUNC *cmp)
 	switch ((cmp(pt1 - 1, pt1) <= 0) | (cmp(pt3 - 1, pt3) <= 0) * 2)
 	{
 		case 0:
+			QUAD_STAT(quadsort_stats.quad_merge_block[0]++);
 			FUNC(cross_merge)(swap, array, block, block, cmp);
 			FUNC(cross_merge)(swap + block_x_2, pt2, block, block, cmp);
 			break;
 		case 1:
+			QUAD_STAT(quadsort_stats.quad_merge_block[1]++);
 			memcpy(swap, array, block_x_2 * sizeof(VAR));
 			FUNC(cross_merge)(swap + block_x_2, pt2, block, block, cmp);
 			break;
 		case 2:
+			QUAD_STAT(quadsort_stats.quad_merge_block[2]++);
 			FUNC(cross_merge)(swap, array, block, block, cmp);
 			memcpy(swap + block_x_2, pt2, block_x_2 * sizeof(VAR));
 			break;
 		case 3:
+			QUAD_STAT(quadsort_stats.quad_merge_block[3]++);
 			if (cmp(pt2 - 1, pt2) <= 0)
 				return;
 			memcpy(swap, array, block_x_2 * 2 * sizeof(VAR));
@@ -549,6 +713,7 @@ void FUNC(quad_merge_block)(VAR *array, VAR *swap, size_t block, CMPFUNC *cmp)
 size_t FUNC(quad_merge)(VAR *array, VAR *swap, size_t swap_size, size_t nmemb, size_t block, CMPFUNC *cmp)
 {
 	VAR *pta, *pte;
+	QUAD_STAT(unsigned long long start = quad_stats_clock());
 
 	pte = array + nmemb;
 
@@ -573,6 +738,8 @@ size_t FUNC(quad_merge)(VAR *array, VAR *swap, size_t swap_size, size_t nmemb, s
 
 	FUNC(tail_merge)(array, swap, swap_size, nmemb, block / 4, cmp);
 
+	QUAD_STAT(quadsort_stats.quad_merge_cycles += quad_stats_clock() - start);
+
 	return block / 2;
 }
 
@@ -645,12 +812,13 @@ void FUNC(partial_forward_merge)(VAR *array, VAR *swap, size_t swap_size, size_t
 	{
 		*array++ = *ptl++;
 	}
+	QUAD_STAT(quadsort_stats.moves += nmemb - (tpr + 1 - ptr));
 }
 
 void FUNC(partial_backward_merge)(VAR *array, VAR *swap, size_t swap_size, size_t nmemb, size_t block, CMPFUNC *cmp)
 {
 	VAR *tpl, *tpa, *tpr;
-	size_t right, loop, x;
+	size_t right, loop, x, skips = 0;
 
 	if (nmemb == block)
 	{
@@ -682,19 +850,43 @@ void FUNC(partial_backward_merge)(VAR *array, VAR *swap, size_t swap_size, size_
 
 	while (tpl > array + 16 && tpr > swap + 16)
 	{
+		skips = 0;
+
 		tpl_tpr16: if (cmp(tpl, tpr - 15) <= 0)
 		{
 			loop = 16; do *tpa-- = *tpr--; while (--loop);
 
+			if (++skips == QUAD_GALLOP && tpr > swap + 16)
+			{
+				loop = FUNC(quad_gallop_tail)(tpr, tpr - swap - 16, tpl, 1, cmp);
+
+				tpa -= loop; tpr -= loop; memcpy(tpa + 1, tpr + 1, loop * sizeof(VAR));
+
+				skips = 0;
+
+				if (tpr > swap + 16) {goto tpl16_tpr;} break;
+			}
 			if (tpr > swap + 16) {goto tpl_tpr16;} break;
 		}
+		skips = 0;
 
 		tpl16_tpr: if (cmp(tpl - 15, tpr) > 0)
 		{
 			loop = 16; do *tpa-- = *tpl--; while (--loop);
-			
+
+			if (++skips == QUAD_GALLOP && tpl > array + 16)
+			{
+				loop = FUNC(quad_gallop_tail)(tpl, tpl - array - 16, tpr, 0, cmp);
+
+				tpa -= loop; tpl -= loop; memmove(tpa + 1, tpl + 1, loop * sizeof(VAR));
+
+				skips = 0;
+
+				if (tpl > array + 16) {goto tpl_tpr16;} break;
+			}
 			if (tpl > array + 16) {goto tpl16_tpr;} break;
 		}
+
 		loop = 8; do
 		{
 			if (cmp(tpl, tpr - 1) <= 0)
@@ -759,11 +951,13 @@ void FUNC(partial_backward_merge)(VAR *array, VAR *swap, size_t swap_size, size_
 	{
 		*tpa-- = *tpr--;
 	}
+	QUAD_STAT(quadsort_stats.moves += nmemb - (tpl + 1 - array));
 }
 
 void FUNC(tail_merge)(VAR *array, VAR *swap, size_t swap_size, size_t nmemb, size_t block, CMPFUNC *cmp)
 {
 	VAR *pta, *pte;
+	QUAD_STAT(unsigned long long start = quad_stats_clock());
 
 	pte = array + nmemb;
 
@@ -783,6 +977,7 @@ void FUNC(tail_merge)(VAR *array, VAR *swap, size_t swap_size, size_t nmemb, siz
 		}
 		block *= 2;
 	}
+	QUAD_STAT(quadsort_stats.tail_merge_cycles += quad_stats_clock() - start);
 }
 
 // the next four functions provide in-place rotate merge support
@@ -791,6 +986,9 @@ void FUNC(trinity_rotation)(VAR *array, VAR *swap, size_t swap_size, size_t nmem
 {
 	VAR temp;
 	size_t bridge, right = nmemb - left;
+	QUAD_STAT(unsigned long long start = quad_stats_clock());
+
+	QUAD_STAT(quadsort_stats.moves += nmemb);
 
 	if (swap_size > 65536)
 	{
@@ -925,6 +1123,7 @@ void FUNC(trinity_rotation)(VAR *array, VAR *swap, size_t swap_size, size_t nmem
 			temp = *pta; *pta++ = *ptb; *ptb++ = temp;
 		}
 	}
+	QUAD_STAT(quadsort_stats.trinity_rotation_cycles += quad_stats_clock() - start);
 }
 
 size_t FUNC(monobound_binary_first)(VAR *array, VAR *value, size_t top, CMPFUNC *cmp)
@@ -952,6 +1151,34 @@ size_t FUNC(monobound_binary_first)(VAR *array, VAR *value, size_t top, CMPFUNC
 	return (end - array);
 }
 
+// merge path co-ranking, returns how many left elements are among the first
+// diag elements of a stable merge of the left and right array
+
+size_t FUNC(monobound_merge_path)(VAR *ptl, size_t left, VAR *ptr, size_t right, size_t diag, CMPFUNC *cmp)
+{
+	size_t base, top, mid;
+
+	base = diag > right ? diag - right : 0;
+	top = (diag < left ? diag : left) - base;
+
+	while (top > 1)
+	{
+		mid = top / 2;
+
+		if (cmp(ptl + base + mid, ptr + diag - base - mid - 1) <= 0)
+		{
+			base += mid;
+		}
+		top -= mid;
+	}
+
+	if (top && cmp(ptl + base, ptr + diag - base - 1) <= 0)
+	{
+		base++;
+	}
+	return base;
+}
+
 void FUNC(rotate_merge_block)(VAR *array, VAR *swap, size_t swap_size, size_t lblock, size_t right, CMPFUNC *cmp)
 {
 	size_t left, rblock, unbalanced;
@@ -1023,6 +1250,7 @@ void FUNC(rotate_merge_block)(VAR *array, VAR *swap, size_t swap_size, size_t lb
 void FUNC(rotate_merge)(VAR *array, VAR *swap, size_t swap_size, size_t nmemb, size_t block, CMPFUNC *cmp)
 {
 	VAR *pta, *pte;
+	QUAD_STAT(unsigned long long start = quad_stats_clock());
 
 	pte = array + nmemb;
 
@@ -1030,6 +1258,8 @@ void FUNC(rotate_merge)(VAR *array, VAR *swap, size_t swap_size, size_t nmemb, s
 	{
 		FUNC(partial_backward_merge)(array, swap, swap_size, nmemb, block, cmp);
 
+		QUAD_STAT(quadsort_stats.rotate_merge_cycles += quad_stats_clock() - start);
+
 		return;
 	}
 
@@ -1049,6 +1279,7 @@ void FUNC(rotate_merge)(VAR *array, VAR *swap, size_t swap_size, size_t nmemb, s
 		}
 		block *= 2;
 	}
+	QUAD_STAT(quadsort_stats.rotate_merge_cycles += quad_stats_clock() - start);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1075,11 +1306,9 @@ void FUNC(quadsort)(void *array, size_t nmemb, CMPFUNC *cmp)
 	else if (FUNC(quad_swap)(pta, nmemb, cmp) == 0)
 	{
 		VAR *swap = NULL;
-		size_t block, swap_size = nmemb;
-
-		if (nmemb > 4194304) for (swap_size = 4194304 ; swap_size * 8 <= nmemb ; swap_size *= 4) {}
+		size_t block, swap_size = quad_swap_size(nmemb);
 
-		swap = (VAR *) malloc(swap_size * sizeof(VAR));
+		swap = (VAR *) quad_malloc(swap_size * sizeof(VAR));
 
 		if (swap == NULL)
 		{
@@ -1095,7 +1324,7 @@ void FUNC(quadsort)(void *array, size_t nmemb, CMPFUNC *cmp)
 
 		FUNC(rotate_merge)(pta, swap, swap_size, nmemb, block, cmp);
 
-		free(swap);
+		quad_free(swap);
 	}
 }
 
@@ -1115,3 +1344,685 @@ void FUNC(quadsort_swap)(void *array, void *swap, size_t swap_size, size_t nmemb
 		FUNC(rotate_merge)(pta, pts, swap_size, nmemb, block, cmp);
 	}
 }
+
+// sorts the tail of an array that starts with block sorted elements and
+// merges it into the prefix, which requires swap memory for the tail only
+
+void FUNC(quadsort_append)(void *array, size_t block, size_t nmemb, CMPFUNC *cmp)
+{
+	VAR *pta = (VAR *) array;
+	VAR *swap;
+	size_t right = nmemb - block;
+
+	if (right == 0)
+	{
+		return;
+	}
+
+	if (block == 0)
+	{
+		FUNC(quadsort)(pta, nmemb, cmp);
+
+		return;
+	}
+
+	swap = (VAR *) quad_malloc(right * sizeof(VAR));
+
+	if (swap == NULL)
+	{
+		VAR stack[512];
+
+		FUNC(quadsort)(pta + block, right, cmp);
+
+		FUNC(rotate_merge_block)(pta, stack, 512, block, right, cmp);
+
+		return;
+	}
+	FUNC(quadsort_swap)(pta + block, swap, right, right, cmp);
+
+	FUNC(partial_backward_merge)(pta, swap, right, nmemb, block, cmp);
+
+	quad_free(swap);
+}
+
+// Leaves the k smallest elements sorted at the front of the array. The front
+// is sorted first, after which every element that goes before the k-th is
+// swapped into a staging area behind the front. A full staging area is
+// sorted and merged with the front, which brings the k-th element down.
+// Candidates are staged in array order and the front wins ties, so the
+// result is stable. The staging area holds at least 512 elements, so
+// descending input doesn't merge on every element.
+
+void FUNC(quadsort_partial)(void *array, size_t nmemb, size_t k, CMPFUNC *cmp)
+{
+	VAR *pta = (VAR *) array;
+	VAR *swap, *pts, *pti, *pte, tmp;
+	size_t swap_size;
+
+	if (k == 0)
+	{
+		return;
+	}
+
+	if (k * 2 >= nmemb)
+	{
+		FUNC(quadsort)(pta, nmemb, cmp);
+
+		return;
+	}
+	swap_size = k < 512 ? 512 : k;
+
+	swap = (VAR *) quad_malloc(swap_size * sizeof(VAR));
+
+	if (swap == NULL)
+	{
+		FUNC(quadsort)(pta, nmemb, cmp);
+
+		return;
+	}
+	FUNC(quadsort_swap)(pta, swap, swap_size, k, cmp);
+
+	pts = pta + k;
+	pte = pta + nmemb;
+
+	for (pti = pts ; pti < pte ; pti++)
+	{
+		if (cmp(pta + k - 1, pti) <= 0)
+		{
+			continue;
+		}
+		tmp = *pts; *pts++ = *pti; *pti = tmp;
+
+		if (pts == pta + k + swap_size)
+		{
+			FUNC(quadsort_swap)(pta + k, swap, swap_size, swap_size, cmp);
+
+			FUNC(partial_backward_merge)(pta, swap, swap_size, k + swap_size, k, cmp);
+
+			pts = pta + k;
+		}
+	}
+
+	if (pts > pta + k)
+	{
+		FUNC(quadsort_swap)(pta + k, swap, swap_size, pts - pta - k, cmp);
+
+		FUNC(partial_backward_merge)(pta, swap, swap_size, pts - pta, k, cmp);
+	}
+	quad_free(swap);
+}
+
+// the next three functions provide a run adaptive sort in the style of
+// powersort, natural runs are pushed on a stack and merged when the power of
+// the new run boundary is lower than that of the boundary below it
+
+// returns the length of the run at the start of the array, descending runs
+// of QUAD_RUN_MIN or more elements are reversed, shorter runs are sorted by
+// the caller
+
+size_t FUNC(quad_natural_run)(VAR *array, size_t nmemb, CMPFUNC *cmp)
+{
+	size_t cnt = 1;
+
+	if (nmemb < 2)
+	{
+		return nmemb;
+	}
+
+	if (cmp(array, array + 1) > 0)
+	{
+		while (cnt + 1 < nmemb && cmp(array + cnt, array + cnt + 1) > 0)
+		{
+			cnt++;
+		}
+		if (++cnt >= QUAD_RUN_MIN)
+		{
+			FUNC(quad_reversal)(array, array + cnt - 1);
+		}
+		return cnt;
+	}
+
+	while (cnt + 1 < nmemb && cmp(array + cnt, array + cnt + 1) <= 0)
+	{
+		cnt++;
+	}
+	return cnt + 1;
+}
+
+// merges two adjacent runs, copying the smaller one to swap when it fits
+
+void FUNC(quad_natural_merge)(VAR *array, VAR *swap, size_t swap_size, size_t left, size_t right, CMPFUNC *cmp)
+{
+	if (cmp(array + left - 1, array + left) <= 0)
+	{
+		return;
+	}
+
+	if (right <= left && right <= swap_size)
+	{
+		FUNC(partial_backward_merge)(array, swap, swap_size, left + right, left, cmp);
+	}
+	else if (left <= swap_size)
+	{
+		FUNC(partial_forward_merge)(array, swap, swap_size, left + right, left, cmp);
+	}
+	else
+	{
+		FUNC(rotate_merge_block)(array, swap, swap_size, left, right, cmp);
+	}
+}
+
+// Runs shorter than QUAD_RUN_MIN elements are extended and sorted with
+// quadsort_swap(). Requires n / 2 swap memory, if allocation fails it sorts
+// with 512 elements of stack memory.
+
+void FUNC(quadsort_natural)(void *array, size_t nmemb, CMPFUNC *cmp)
+{
+	VAR *pta = (VAR *) array;
+	VAR *swap, stack[512];
+	size_t swap_size, start, run, top, power;
+	size_t runs[QUAD_RUN_STACK], lens[QUAD_RUN_STACK], powers[QUAD_RUN_STACK];
+
+	if (nmemb < 32)
+	{
+		FUNC(tail_swap)(pta, stack, nmemb, cmp);
+
+		return;
+	}
+	swap_size = nmemb / 2 > QUAD_RUN_MIN ? nmemb / 2 : QUAD_RUN_MIN;
+
+	swap = (VAR *) quad_malloc(swap_size * sizeof(VAR));
+
+	if (swap == NULL)
+	{
+		swap = stack;
+		swap_size = 512;
+	}
+
+	for (start = top = 0 ; start < nmemb ; start += run)
+	{
+		run = FUNC(quad_natural_run)(pta + start, nmemb - start, cmp);
+
+		if (run < QUAD_RUN_MIN)
+		{
+			run = nmemb - start < QUAD_RUN_MIN ? nmemb - start : QUAD_RUN_MIN;
+
+			FUNC(quadsort_swap)(pta + start, swap, swap_size, run, cmp);
+		}
+
+		if (top)
+		{
+			power = quad_run_power(runs[top - 1], lens[top - 1], run, nmemb);
+
+			while (top > 1 && powers[top - 2] > power)
+			{
+				FUNC(quad_natural_merge)(pta + runs[top - 2], swap, swap_size, lens[top - 2], lens[top - 1], cmp);
+
+				lens[top - 2] += lens[top - 1];
+				top--;
+			}
+			powers[top - 1] = power;
+		}
+		runs[top] = start;
+		lens[top] = run;
+		top++;
+	}
+
+	while (top > 1)
+	{
+		FUNC(quad_natural_merge)(pta + runs[top - 2], swap, swap_size, lens[top - 2], lens[top - 1], cmp);
+
+		lens[top - 2] += lens[top - 1];
+		top--;
+	}
+
+	if (swap != stack)
+	{
+		quad_free(swap);
+	}
+}
+
+// the next two functions provide stable selection, the array is split into
+// smaller, equal, and larger elements with a stable three way partition, so
+// every rank ends up with the element a stable sort would put there
+
+VAR *FUNC(quad_median_of_three)(VAR *pta, VAR *ptb, VAR *ptc, CMPFUNC *cmp)
+{
+	if (cmp(pta, ptb) > 0)
+	{
+		VAR *tmp = pta; pta = ptb; ptb = tmp;
+	}
+	if (cmp(ptb, ptc) <= 0)
+	{
+		return ptb;
+	}
+	return cmp(pta, ptc) > 0 ? pta : ptc;
+}
+
+// ranks are sorted and relative to the array, depth limits the number of bad
+// partitions before the segment is sorted instead
+
+void FUNC(quad_select)(VAR *array, VAR *swap, size_t nmemb, size_t *ranks, size_t m, size_t depth, CMPFUNC *cmp)
+{
+	VAR *pta, *ptd, *pts, *pte, piv;
+	size_t step, less, equal, split, cnt, high, low;
+
+	while (m)
+	{
+		if (nmemb <= 32 || depth-- == 0 || m * 8 > nmemb)
+		{
+			FUNC(quadsort_swap)(array, swap, nmemb, nmemb, cmp);
+
+			return;
+		}
+		step = nmemb / 8;
+
+		piv = *FUNC(quad_median_of_three)(
+			FUNC(quad_median_of_three)(array, array + step, array + step * 2, cmp),
+			FUNC(quad_median_of_three)(array + step * 3, array + step * 4, array + step * 5, cmp),
+			FUNC(quad_median_of_three)(array + step * 6, array + step * 7, array + nmemb - 1, cmp), cmp);
+
+		ptd = array;
+		pts = swap;
+		pte = swap + nmemb;
+
+		for (pta = array ; pta < array + nmemb ; pta++)
+		{
+			high = cmp(pta, &piv) > 0;
+			low = cmp(&piv, pta) > 0;
+
+			pte[-1] = *pta; *ptd = *pta; *pts = *pta;
+
+			pte -= high; ptd += low; pts += !(high | low);
+		}
+		less = ptd - array;
+		equal = pts - swap;
+
+		memcpy(ptd, swap, equal * sizeof(VAR));
+
+		ptd += equal;
+
+		for (pts = swap + nmemb ; pts > pte ; )
+		{
+			*ptd++ = *--pts;
+		}
+
+		for (split = 0 ; split < m && ranks[split] < less ; split++) {}
+
+		if (split)
+		{
+			FUNC(quad_select)(array, swap, less, ranks, split, depth, cmp);
+		}
+
+		for ( ; split < m && ranks[split] < less + equal ; split++) {}
+
+		ranks += split;
+		m -= split;
+
+		for (cnt = 0 ; cnt < m ; cnt++)
+		{
+			ranks[cnt] -= less + equal;
+		}
+		array += less + equal;
+		nmemb -= less + equal;
+	}
+}
+
+// Stable multi selection, ranks must be sorted and below nmemb and are
+// overwritten. Requires n swap memory, if allocation fails the array is
+// sorted instead.
+
+void FUNC(quadsort_select)(void *array, size_t nmemb, size_t *ranks, size_t m, CMPFUNC *cmp)
+{
+	VAR *pta = (VAR *) array;
+	VAR *swap;
+	size_t depth, cnt;
+
+	if (m == 0 || nmemb < 2)
+	{
+		return;
+	}
+
+	swap = (VAR *) quad_malloc(nmemb * sizeof(VAR));
+
+	if (swap == NULL)
+	{
+		FUNC(quadsort)(pta, nmemb, cmp);
+
+		return;
+	}
+
+	for (depth = 0, cnt = nmemb ; cnt ; cnt /= 2)
+	{
+		depth += 2;
+	}
+	FUNC(quad_select)(pta, swap, nmemb, ranks, m, depth, cmp);
+
+	quad_free(swap);
+}
+
+// merges k sorted runs into dest as a balanced tree of cross merges, the
+// first level reads the runs directly, after which the merged runs are
+// ping-ponged between dest and swap so the last level ends in dest. The len
+// array is overwritten and the runs must be non-empty.
+
+void FUNC(quad_merge_k)(void *dest, void *swap, void **runs, size_t *len, size_t k, CMPFUNC *cmp)
+{
+	VAR *from, *to, *pta;
+	size_t levels, cnt, run;
+
+	for (levels = 0, cnt = 1 ; cnt < k ; cnt *= 2)
+	{
+		levels++;
+	}
+	to = (VAR *) (levels % 2 ? dest : swap);
+	pta = to;
+
+	for (run = 0 ; run + 1 < k ; run += 2)
+	{
+		FUNC(cross_merge_split)(pta, (VAR *) runs[run], len[run], (VAR *) runs[run + 1], len[run + 1], cmp);
+
+		len[run / 2] = len[run] + len[run + 1];
+		pta += len[run / 2];
+	}
+	if (run < k)
+	{
+		memcpy(pta, runs[run], len[run] * sizeof(VAR));
+
+		len[run / 2] = len[run];
+	}
+	k = (k + 1) / 2;
+
+	while (k > 1)
+	{
+		from = to;
+		to = (VAR *) (from == dest ? swap : dest);
+		pta = to;
+
+		for (run = 0 ; run + 1 < k ; run += 2)
+		{
+			FUNC(cross_merge)(pta, from, len[run], len[run + 1], cmp);
+
+			len[run / 2] = len[run] + len[run + 1];
+			pta += len[run / 2];
+			from += len[run / 2];
+		}
+		if (run < k)
+		{
+			memcpy(pta, from, len[run] * sizeof(VAR));
+
+			len[run / 2] = len[run];
+		}
+		k = (k + 1) / 2;
+	}
+}
+
+#ifdef QUADSORT_MT
+
+// the next four functions provide multithreaded support, each thread sorts
+// its own chunk, after which the chunks are ping-pong merged level by level.
+// Each merge is split into balanced segments using merge path co-ranking so
+// the last levels keep every thread busy.
+
+void FUNC(quad_sort_task)(QUADTASK *task)
+{
+	FUNC(quadsort_swap)(task->array, task->swap, task->nmemb, task->nmemb, task->cmp);
+}
+
+void FUNC(quad_merge_task)(QUADTASK *task)
+{
+	VAR *pta = (VAR *) task->array;
+	VAR *pts = (VAR *) task->swap;
+	VAR *ptr = pta + task->left;
+	size_t right = task->nmemb - task->left;
+	size_t lo, hi;
+	CMPFUNC *cmp = task->cmp;
+
+	if (right == 0 || cmp(ptr - 1, ptr) <= 0)
+	{
+		memcpy(pts + task->start, pta + task->start, (task->end - task->start) * sizeof(VAR));
+
+		return;
+	}
+	lo = FUNC(monobound_merge_path)(pta, task->left, ptr, right, task->start, cmp);
+	hi = FUNC(monobound_merge_path)(pta, task->left, ptr, right, task->end, cmp);
+
+	pts += task->start;
+	ptr += task->start - lo;
+	right = task->end - task->start - (hi - lo);
+
+	if (hi == lo)
+	{
+		memcpy(pts, ptr, right * sizeof(VAR));
+	}
+	else if (right == 0)
+	{
+		memcpy(pts, pta + lo, (hi - lo) * sizeof(VAR));
+	}
+	else
+	{
+		FUNC(cross_merge_split)(pts, pta + lo, hi - lo, ptr, right, cmp);
+	}
+}
+
+void FUNC(quad_copy_task)(QUADTASK *task)
+{
+	memcpy(task->array, task->swap, task->nmemb * sizeof(VAR));
+}
+
+void FUNC(quadsort_mt)(void *array, size_t nmemb, CMPFUNC *cmp, size_t threads)
+{
+	VAR *pta = (VAR *) array, *swap, *ptf, *ptd;
+	size_t parts, cnt, count, width, lo, mid, hi, segs, seg;
+
+	parts = nmemb / QUAD_MT_MIN < threads ? nmemb / QUAD_MT_MIN : threads;
+
+	if (parts < 2)
+	{
+		FUNC(quadsort)(array, nmemb, cmp);
+
+		return;
+	}
+
+	swap = (VAR *) quad_malloc(nmemb * sizeof(VAR));
+
+	if (swap == NULL)
+	{
+		FUNC(quadsort)(array, nmemb, cmp);
+
+		return;
+	}
+
+	QUADTASK tasks[parts * 2];
+	size_t bound[parts + 1];
+
+	for (cnt = 0 ; cnt <= parts ; cnt++)
+	{
+		bound[cnt] = nmemb * cnt / parts;
+	}
+
+	for (cnt = 0 ; cnt < parts ; cnt++)
+	{
+		tasks[cnt].func = FUNC(quad_sort_task);
+		tasks[cnt].array = pta + bound[cnt];
+		tasks[cnt].swap = swap + bound[cnt];
+		tasks[cnt].nmemb = bound[cnt + 1] - bound[cnt];
+		tasks[cnt].cmp = cmp;
+	}
+	quad_run_tasks(tasks, parts, threads);
+
+	ptf = pta;
+	ptd = swap;
+
+	for (width = 1 ; width < parts ; width *= 2)
+	{
+		for (count = cnt = 0 ; cnt < parts ; cnt += width * 2)
+		{
+			lo = bound[cnt];
+			mid = bound[cnt + width < parts ? cnt + width : parts];
+			hi = bound[cnt + width * 2 < parts ? cnt + width * 2 : parts];
+
+			segs = (parts * (hi - lo) + nmemb - 1) / nmemb;
+
+			for (seg = 0 ; seg < segs ; seg++, count++)
+			{
+				tasks[count].func = FUNC(quad_merge_task);
+				tasks[count].array = ptf + lo;
+				tasks[count].swap = ptd + lo;
+				tasks[count].nmemb = hi - lo;
+				tasks[count].left = mid - lo;
+				tasks[count].start = (hi - lo) * seg / segs;
+				tasks[count].end = (hi - lo) * (seg + 1) / segs;
+				tasks[count].cmp = cmp;
+			}
+		}
+		quad_run_tasks(tasks, count, threads);
+
+		ptd = ptf;
+		ptf = (ptf == pta) ? swap : pta;
+	}
+
+	if (ptf != pta)
+	{
+		for (cnt = 0 ; cnt < parts ; cnt++)
+		{
+			tasks[cnt].func = FUNC(quad_copy_task);
+			tasks[cnt].array = pta + bound[cnt];
+			tasks[cnt].swap = swap + bound[cnt];
+			tasks[cnt].nmemb = bound[cnt + 1] - bound[cnt];
+		}
+		quad_run_tasks(tasks, parts, threads);
+	}
+	quad_free(swap);
+}
+
+#endif
+
+#ifdef QUAD_KV
+
+// VAR is a key value pair, the keys and values are interleaved so the merges
+// move them together with an inlined comparison of the keys
+
+void FUNC(quadsort_kv)(void *keys, void *values, size_t nmemb)
+{
+	VAR *pairs, *ptp;
+	char *ptk = (char *) keys, *ptv = (char *) values;
+	size_t cnt;
+
+	if (nmemb < 2)
+	{
+		return;
+	}
+	pairs = (VAR *) quad_malloc(nmemb * sizeof(VAR));
+
+	assert(pairs != NULL);
+
+	for (ptp = pairs, cnt = nmemb ; cnt ; cnt--, ptp++)
+	{
+		memcpy(&ptp->key, ptk, sizeof(ptp->key)); ptk += sizeof(ptp->key);
+		memcpy(&ptp->value, ptv, sizeof(ptp->value)); ptv += sizeof(ptp->value);
+	}
+
+	FUNC(quadsort)(pairs, nmemb, NULL);
+
+	ptk = (char *) keys;
+	ptv = (char *) values;
+
+	for (ptp = pairs, cnt = nmemb ; cnt ; cnt--, ptp++)
+	{
+		memcpy(ptk, &ptp->key, sizeof(ptp->key)); ptk += sizeof(ptp->key);
+		memcpy(ptv, &ptp->value, sizeof(ptp->value)); ptv += sizeof(ptp->value);
+	}
+	quad_free(pairs);
+}
+
+// the perm array has the width of the value, or size_t for 64 bit values
+
+void FUNC(quadsort_argsort)(const void *array, size_t nmemb, void *perm)
+{
+	VAR *pairs, *ptp;
+	const char *ptk = (const char *) array;
+	size_t cnt;
+
+	if (nmemb < 2)
+	{
+		if (nmemb == 1)
+		{
+			if (sizeof(ptp->value) == sizeof(unsigned int))
+			{
+				*(unsigned int *) perm = 0;
+			}
+			else
+			{
+				*(size_t *) perm = 0;
+			}
+		}
+		return;
+	}
+
+	pairs = (VAR *) quad_malloc(nmemb * sizeof(VAR));
+
+	assert(pairs != NULL);
+
+	for (ptp = pairs, cnt = 0 ; cnt < nmemb ; cnt++, ptp++)
+	{
+		memcpy(&ptp->key, ptk, sizeof(ptp->key)); ptk += sizeof(ptp->key);
+		ptp->value = cnt;
+	}
+
+	FUNC(quadsort)(pairs, nmemb, NULL);
+
+	for (ptp = pairs, cnt = 0 ; cnt < nmemb ; cnt++, ptp++)
+	{
+		if (sizeof(ptp->value) == sizeof(unsigned int))
+		{
+			((unsigned int *) perm)[cnt] = ptp->value;
+		}
+		else
+		{
+			((size_t *) perm)[cnt] = ptp->value;
+		}
+	}
+	quad_free(pairs);
+}
+
+#endif
+
+#ifdef QUAD_ARG
+
+// VAR is an index into the array stored in quad_arg, which is restored when
+// done in case the comparison function uses argsort itself
+
+void FUNC(quadsort_argsort)(const void *array, size_t nmemb, size_t size, CMPFUNC *cmp, VAR *perm)
+{
+	QUADARG save = quad_arg;
+	size_t cnt;
+
+	for (cnt = 0 ; cnt < nmemb ; cnt++)
+	{
+		perm[cnt] = cnt;
+	}
+
+	if (nmemb < 2)
+	{
+		return;
+	}
+
+	quad_arg.base = (const char *) array;
+	quad_arg.size = size;
+	quad_arg.cmp = cmp;
+
+	FUNC(quadsort)(perm, nmemb, cmp);
+
+	quad_arg = save;
+}
+
+#endif
+
+#ifdef QUADSORT_STATS
+  #ifdef QUAD_STATS_CMP
+    #undef QUAD_STATS_CMP
+    #undef cmp
+  #endif
+  #undef memcpy
+#endif
@@ -10,27 +10,238 @@
 #include <float.h>
 #include <string.h>
 
+// quadsort_mt() needs POSIX threads, it's only compiled when QUADSORT_MT is
+// defined, which is the default on unix systems unless QUADSORT_NO_MT is
+// defined. The rest of quadsort is portable C.
+
+#if !defined QUADSORT_MT && !defined QUADSORT_NO_MT && (defined __unix__ || defined __APPLE__)
+  #define QUADSORT_MT
+#endif
+
+#if defined QUADSORT_MT || defined __unix__ || defined __APPLE__
+  #include <unistd.h>
+#endif
+
+#ifdef QUADSORT_MT
+  #include <pthread.h>
+#endif
+
 //#include <stdalign.h>
 
 typedef int CMPFUNC (const void *a, const void *b);
 
+// The comparison function reads the elements through their real type, which
+// may be a structure of the same size, so the element types alias anything.
+
+#if defined __GNUC__
+  #define QUAD_ALIAS __attribute__((__may_alias__))
+#else
+  #define QUAD_ALIAS
+#endif
+
+typedef short QUAD_ALIAS quad_alias16;
+typedef int QUAD_ALIAS quad_alias32;
+typedef long long QUAD_ALIAS quad_alias64;
+
+// long doubles are moved as bytes as x87 loads and stores drop the padding,
+// which may hold data when sorting records of the same size
+
+#ifndef cmp
+typedef struct {char bytes[sizeof(long double)];} QUAD_ALIAS quad_alias128;
+#else
+typedef long double QUAD_ALIAS quad_alias128;
+#endif
+
 //#define cmp(a,b) (*(a) > *(b))
 
 
-// When sorting an array of pointers, like a string array, the QUAD_CACHE needs
-// to be set for proper performance when sorting large arrays.
+// When sorting an array of pointers, like a string array, gcc's branchless
+// merges slow down once the merged data no longer fits the cache, so merges
+// with more than QUAD_CACHE elements per side use branching merges instead.
 // quadsort_prim() can be used to sort arrays of 32 and 64 bit integers
 // without a comparison function or cache restrictions.
 
-// With a 6 MB L3 cache a value of 262144 works well.
+// With a 6 MB L3 cache a value of 262144 pointers works well, which is a
+// third of the cache. The limit is kept in bytes and divided by the element
+// size. It is set at startup from the QUADSORT_CACHE environment variable,
+// or the size of the last level cache, and can be changed with
+// quadsort_set_cache(). Both take a size in bytes with an optional K, M, or
+// G suffix for the environment variable. Without gcc's constructor attribute
+// the 6 MB default is used until quadsort_set_cache() is called.
+
+#define QUAD_CACHE_DEFAULT 6291456
+
+size_t quad_cache_limit = QUAD_CACHE_DEFAULT / 3;
 
 #ifdef cmp
   #define QUAD_CACHE 4294967295
 #else
-//#define QUAD_CACHE 131072
-  #define QUAD_CACHE 262144
-//#define QUAD_CACHE 524288
-//#define QUAD_CACHE 4294967295
+  #define QUAD_CACHE (quad_cache_limit / sizeof(VAR))
+#endif
+
+size_t quad_cache_parse(const char *text)
+{
+	char *end;
+	size_t size = strtoull(text, &end, 10);
+
+	switch (*end)
+	{
+		case 'G': case 'g': return size << 30;
+		case 'M': case 'm': return size << 20;
+		case 'K': case 'k': return size << 10;
+	}
+	return size;
+}
+
+// the data or unified cache of cpu0 with the highest level, from sysfs
+
+size_t quad_cache_sysfs(void)
+{
+	char path[64], text[32];
+	size_t level, size, best_level = 2, best = 0;
+	FILE *file;
+	int index;
+
+	for (index = 0 ; index < 16 ; index++)
+	{
+		sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+
+		if ((file = fopen(path, "r")) == NULL)
+		{
+			break;
+		}
+		level = fgets(text, sizeof(text), file) ? strtoul(text, NULL, 10) : 0;
+		fclose(file);
+
+		sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+
+		if (level < best_level || (file = fopen(path, "r")) == NULL)
+		{
+			continue;
+		}
+		size = fgets(text, sizeof(text), file) ? quad_cache_parse(text) : 0;
+		fclose(file);
+
+		if (size && (level > best_level || size > best))
+		{
+			best_level = level;
+			best = size;
+		}
+	}
+	return best;
+}
+
+size_t quad_cache_detect(void)
+{
+	const char *env = getenv("QUADSORT_CACHE");
+	long size = 0;
+
+	if (env && quad_cache_parse(env))
+	{
+		return quad_cache_parse(env);
+	}
+#ifdef _SC_LEVEL3_CACHE_SIZE
+	size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+	if (size <= 0)
+	{
+		size = quad_cache_sysfs();
+	}
+#ifdef _SC_LEVEL2_CACHE_SIZE
+	if (size <= 0)
+	{
+		size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	}
+#endif
+	return size > 0 ? size : QUAD_CACHE_DEFAULT;
+}
+
+// passing 0 detects the cache size again
+
+void quadsort_set_cache(size_t bytes)
+{
+	quad_cache_limit = (bytes ? bytes : quad_cache_detect()) / 3;
+}
+
+#if defined __GNUC__
+__attribute__((constructor)) void quad_cache_init(void)
+{
+	quadsort_set_cache(0);
+}
+#endif
+
+// Defining QUADSORT_STATS makes the sort routines record what they do in
+// quadsort_stats, which is thread local and adds up over calls, so call
+// quadsort_stats_reset() before the sort to measure. Compares made by the
+// SIMD merges aren't counted. Moves are the elements written by the merge
+// and rotation routines. Cycles are inclusive, so the cycles of quad_merge()
+// include those of the tail_merge() calls it makes. Without QUADSORT_STATS
+// the QUAD_STAT() and QUAD_COUNT() macros compile to nothing.
+
+#ifdef QUADSORT_STATS
+
+#include <time.h>
+
+#if defined __x86_64__ || defined __i386__
+  #include <x86intrin.h>
+#endif
+
+typedef struct
+{
+	size_t compares;
+	size_t moves;
+	size_t memcpy_bytes;
+
+	unsigned long long quad_swap_cycles;
+	unsigned long long quad_merge_cycles;
+	unsigned long long tail_merge_cycles;
+	unsigned long long rotate_merge_cycles;
+	unsigned long long trinity_rotation_cycles;
+
+	size_t quad_merge_block[4];
+	size_t quad_swap_ordered;
+	size_t quad_swap_reversed;
+} QUADSTATS;
+
+__thread QUADSTATS quadsort_stats;
+
+void quadsort_stats_reset(void)
+{
+	memset(&quadsort_stats, 0, sizeof(QUADSTATS));
+}
+
+unsigned long long quad_stats_clock(void)
+{
+#if defined __x86_64__ || defined __i386__
+	return __rdtsc();
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+int quad_stats_compare(int result)
+{
+	quadsort_stats.compares++;
+
+	return result;
+}
+
+void *quad_stats_memcpy(void *dest, const void *src, size_t size)
+{
+	quadsort_stats.memcpy_bytes += size;
+
+	return memcpy(dest, src, size);
+}
+
+  #define QUAD_STAT(code) code
+  #define QUAD_COUNT(compare) quad_stats_compare(compare)
+#else
+  #define QUAD_STAT(code)
+  #define QUAD_COUNT(compare) (compare)
 #endif
 
 // utilize branchless ternary operations in clang
@@ -107,6 +318,203 @@ typedef int CMPFUNC (const void *a, const void *b);
 	pta[0] = pta[x];  \
 	pta[1] = swap;
 
+// All memory is allocated through quad_malloc() and quad_free(), which use
+// malloc() and free() unless quadsort_set_allocator() installed a custom
+// allocator, like an arena or pool. The ctx pointer is passed along as is.
+
+typedef void *QUADALLOC (size_t size, void *ctx);
+typedef void QUADFREE (void *ptr, void *ctx);
+
+typedef struct
+{
+	QUADALLOC *alloc;
+	QUADFREE *dealloc;
+	void *ctx;
+} QUADALLOCATOR;
+
+QUADALLOCATOR quad_allocator;
+
+void *quad_malloc(size_t size)
+{
+	if (quad_allocator.alloc)
+	{
+		return quad_allocator.alloc(size, quad_allocator.ctx);
+	}
+	return malloc(size);
+}
+
+void quad_free(void *ptr)
+{
+	if (quad_allocator.alloc)
+	{
+		quad_allocator.dealloc(ptr, quad_allocator.ctx);
+		return;
+	}
+	free(ptr);
+}
+
+// passing NULL for alloc restores malloc() and free()
+
+void quadsort_set_allocator(QUADALLOC *alloc, QUADFREE *dealloc, void *ctx)
+{
+	assert(alloc == NULL || dealloc != NULL);
+
+	quad_allocator.alloc = alloc;
+	quad_allocator.dealloc = dealloc;
+	quad_allocator.ctx = ctx;
+}
+
+// the number of swap elements quadsort() uses, beyond 4194304 elements it is
+// limited to between 1/8th and 1/2 of the array
+
+size_t quad_swap_size(size_t nmemb)
+{
+	size_t swap_size = nmemb;
+
+	if (nmemb > 4194304) for (swap_size = 4194304 ; swap_size * 8 <= nmemb ; swap_size *= 4) {}
+
+	return swap_size;
+}
+
+// The node power of the boundary between two adjacent runs is the depth at
+// which the boundary would split a perfectly balanced merge tree, computed
+// from the midpoints of the runs. Powers on the run stack strictly increase,
+// which bounds the stack by the number of bits in size_t plus one. Runs
+// shorter than QUAD_RUN_MIN are extended and sorted.
+
+#define QUAD_RUN_STACK 72
+#define QUAD_RUN_MIN 512
+
+size_t quad_run_power(size_t start, size_t left, size_t right, size_t nmemb)
+{
+	size_t a = start * 2 + left, b = a + left + right, power = 0;
+
+	while (1)
+	{
+		power++;
+
+		if (a >= nmemb)
+		{
+			a -= nmemb;
+			b -= nmemb;
+		}
+		else if (b >= nmemb)
+		{
+			break;
+		}
+		a *= 2;
+		b *= 2;
+	}
+	return power;
+}
+
+// A merge gallops once one side has won QUAD_GALLOP skips in a row, fewer
+// make merges of random data pay for galloping searches that end early.
+
+#ifndef QUAD_GALLOP
+  #define QUAD_GALLOP 4
+#endif
+
+#ifdef QUADSORT_MT
+
+// quadsort_mt() splits its work into tasks which are handed out to a pool of
+// threads, the calling thread takes part as well. Chunks smaller than
+// QUAD_MT_MIN elements aren't worth the thread overhead.
+
+#define QUAD_MT_MIN 65536
+
+typedef struct quad_task QUADTASK;
+
+struct quad_task
+{
+	void (*func)(QUADTASK *task);
+	void *array;
+	void *swap;
+	size_t nmemb;
+	size_t left;
+	size_t start;
+	size_t end;
+	CMPFUNC *cmp;
+};
+
+typedef struct
+{
+	QUADTASK *tasks;
+	size_t count;
+	size_t next;
+	pthread_mutex_t lock;
+} QUADPOOL;
+
+void *quad_worker(void *arg)
+{
+	QUADPOOL *pool = (QUADPOOL *) arg;
+	QUADTASK *task;
+
+	while (1)
+	{
+		pthread_mutex_lock(&pool->lock);
+
+		task = pool->next < pool->count ? &pool->tasks[pool->next++] : NULL;
+
+		pthread_mutex_unlock(&pool->lock);
+
+		if (task == NULL)
+		{
+			return NULL;
+		}
+		task->func(task);
+	}
+}
+
+// if a thread can't be created the remaining threads pick up the slack
+
+void quad_run_tasks(QUADTASK *tasks, size_t count, size_t threads)
+{
+	QUADPOOL pool;
+	size_t cnt, spawned;
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (threads > count)
+	{
+		threads = count;
+	}
+
+	pthread_t tid[threads];
+
+	pool.tasks = tasks;
+	pool.count = count;
+	pool.next = 0;
+
+	pthread_mutex_init(&pool.lock, NULL);
+
+	for (spawned = 0 ; spawned + 1 < threads ; spawned++)
+	{
+		if (pthread_create(&tid[spawned], NULL, quad_worker, &pool))
+		{
+			break;
+		}
+	}
+	quad_worker(&pool);
+
+	for (cnt = 0 ; cnt < spawned ; cnt++)
+	{
+		pthread_join(tid[cnt], NULL);
+	}
+	pthread_mutex_destroy(&pool.lock);
+}
+
+#endif
+
+// vectorized sorting networks for quadsort_prim()
+
+#if defined __AVX2__
+  #include "quadsort_simd.h"
+#endif
+
 //////////////////////////////////////////////////////////
 // ┌───────────────────────────────────────────────────┐//
 // │       ██████┐ ██████┐    ██████┐ ██████┐████████┐ │//
@@ -118,7 +526,7 @@ typedef int CMPFUNC (const void *a, const void *b);
 // └───────────────────────────────────────────────────┘//
 //////////////////////////////////////////////////////////
 
-#define VAR int
+#define VAR quad_alias32
 #define FUNC(NAME) NAME##32
 
 #include "quadsort.c"
@@ -131,8 +539,14 @@ typedef int CMPFUNC (const void *a, const void *b);
 #define VAR int
 #define FUNC(NAME) NAME##_int32
 #ifndef cmp
-  #define cmp(a,b) (*(a) > *(b))
+  #define cmp(a,b) QUAD_COUNT(*(a) > *(b))
+  #ifdef QUADSORT_SIMD_H
+    #define QUAD_SIMD(NAME) NAME##_epi32
+    #define QUAD_BIAS 0
+  #endif
   #include "quadsort.c"
+  #undef QUAD_SIMD
+  #undef QUAD_BIAS
   #undef cmp
 #else
   #include "quadsort.c"
@@ -143,8 +557,14 @@ typedef int CMPFUNC (const void *a, const void *b);
 #define VAR unsigned int
 #define FUNC(NAME) NAME##_uint32
 #ifndef cmp
-  #define cmp(a,b) (*(a) > *(b))
+  #define cmp(a,b) QUAD_COUNT(*(a) > *(b))
+  #ifdef QUADSORT_SIMD_H
+    #define QUAD_SIMD(NAME) NAME##_epi32
+    #define QUAD_BIAS 0x80000000
+  #endif
   #include "quadsort.c"
+  #undef QUAD_SIMD
+  #undef QUAD_BIAS
   #undef cmp
 #else
   #include "quadsort.c"
@@ -163,7 +583,7 @@ typedef int CMPFUNC (const void *a, const void *b);
 // └───────────────────────────────────────────────────┘//
 //////////////////////////////////////////////////////////
 
-#define VAR long long
+#define VAR quad_alias64
 #define FUNC(NAME) NAME##64
 
 #include "quadsort.c"
@@ -176,8 +596,14 @@ typedef int CMPFUNC (const void *a, const void *b);
 #define VAR long long
 #define FUNC(NAME) NAME##_int64
 #ifndef cmp
-  #define cmp(a,b) (*(a) > *(b))
+  #define cmp(a,b) QUAD_COUNT(*(a) > *(b))
+  #ifdef QUADSORT_SIMD_H
+    #define QUAD_SIMD(NAME) NAME##_epi64
+    #define QUAD_BIAS 0
+  #endif
   #include "quadsort.c"
+  #undef QUAD_SIMD
+  #undef QUAD_BIAS
   #undef cmp
 #else
   #include "quadsort.c"
@@ -188,8 +614,14 @@ typedef int CMPFUNC (const void *a, const void *b);
 #define VAR unsigned long long
 #define FUNC(NAME) NAME##_uint64
 #ifndef cmp
-  #define cmp(a,b) (*(a) > *(b))
+  #define cmp(a,b) QUAD_COUNT(*(a) > *(b))
+  #ifdef QUADSORT_SIMD_H
+    #define QUAD_SIMD(NAME) NAME##_epi64
+    #define QUAD_BIAS 0x8000000000000000
+  #endif
   #include "quadsort.c"
+  #undef QUAD_SIMD
+  #undef QUAD_BIAS
   #undef cmp
 #else
   #include "quadsort.c"
@@ -197,6 +629,105 @@ typedef int CMPFUNC (const void *a, const void *b);
 #undef VAR
 #undef FUNC
 
+// quadsort_kv, the pairs are compared by key only, so a user defined cmp()
+// is set aside while they and the argsort indices are instantiated
+
+#pragma push_macro("cmp")
+#undef cmp
+#define cmp(a,b) QUAD_COUNT((a)->key > (b)->key)
+#define QUAD_KV
+
+typedef struct {int key; unsigned int value;} kv_int32_32;
+typedef struct {unsigned int key; unsigned int value;} kv_uint32_32;
+typedef struct {long long key; unsigned int value;} kv_int64_32;
+typedef struct {unsigned long long key; unsigned int value;} kv_uint64_32;
+typedef struct {int key; unsigned long long value;} kv_int32_64;
+typedef struct {unsigned int key; unsigned long long value;} kv_uint32_64;
+typedef struct {long long key; unsigned long long value;} kv_int64_64;
+typedef struct {unsigned long long key; unsigned long long value;} kv_uint64_64;
+
+#define VAR kv_int32_32
+#define FUNC(NAME) NAME##_int32_32
+#include "quadsort.c"
+#undef VAR
+#undef FUNC
+
+#define VAR kv_uint32_32
+#define FUNC(NAME) NAME##_uint32_32
+#include "quadsort.c"
+#undef VAR
+#undef FUNC
+
+#define VAR kv_int64_32
+#define FUNC(NAME) NAME##_int64_32
+#include "quadsort.c"
+#undef VAR
+#undef FUNC
+
+#define VAR kv_uint64_32
+#define FUNC(NAME) NAME##_uint64_32
+#include "quadsort.c"
+#undef VAR
+#undef FUNC
+
+#define VAR kv_int32_64
+#define FUNC(NAME) NAME##_int32_64
+#include "quadsort.c"
+#undef VAR
+#undef FUNC
+
+#define VAR kv_uint32_64
+#define FUNC(NAME) NAME##_uint32_64
+#include "quadsort.c"
+#undef VAR
+#undef FUNC
+
+#define VAR kv_int64_64
+#define FUNC(NAME) NAME##_int64_64
+#include "quadsort.c"
+#undef VAR
+#undef FUNC
+
+#define VAR kv_uint64_64
+#define FUNC(NAME) NAME##_uint64_64
+#include "quadsort.c"
+#undef VAR
+#undef FUNC
+
+#undef QUAD_KV
+#undef cmp
+
+// quadsort_argsort, the indices are compared by the elements they refer to,
+// the array and comparison function are kept in a thread local context.
+
+typedef struct
+{
+	const char *base;
+	size_t size;
+	CMPFUNC *cmp;
+} QUADARG;
+
+__thread QUADARG quad_arg;
+
+#define cmp(a,b) QUAD_COUNT(quad_arg.cmp(quad_arg.base + *(a) * quad_arg.size, quad_arg.base + *(b) * quad_arg.size))
+#define QUAD_ARG
+
+#define VAR unsigned int
+#define FUNC(NAME) NAME##_arg32
+#include "quadsort.c"
+#undef VAR
+#undef FUNC
+
+#define VAR size_t
+#define FUNC(NAME) NAME##_argsize
+#include "quadsort.c"
+#undef VAR
+#undef FUNC
+
+#undef QUAD_ARG
+#undef cmp
+#pragma pop_macro("cmp")
+
 // This section is outside of 32/64 bit pointer territory, so no cache checks
 // necessary, unless sorting 32+ byte structures.
 
@@ -233,7 +764,7 @@ typedef int CMPFUNC (const void *a, const void *b);
 //└────────────────────────────────────────────────────┘//
 //////////////////////////////////////////////////////////
 
-#define VAR short
+#define VAR quad_alias16
 #define FUNC(NAME) NAME##16
 
 #include "quadsort.c"
@@ -256,7 +787,7 @@ typedef int CMPFUNC (const void *a, const void *b);
 // 96, or 128 bits, depending on platform.
 
 #if (DBL_MANT_DIG < LDBL_MANT_DIG)
-  #define VAR long double
+  #define VAR quad_alias128
   #define FUNC(NAME) NAME##128
   #include "quadsort.c"
   #undef VAR
@@ -274,16 +805,46 @@ typedef int CMPFUNC (const void *a, const void *b);
 //└─────────────────────────────────────────────────────┘//
 ///////////////////////////////////////////////////////////
 
-/*
-typedef struct {char bytes[32];} struct256;
+// Records are copied by struct assignment, which allows the compiler to use
+// fixed size moves. Other sizes are handled by quadsort() with an argsort.
+
+#ifndef cmp
+typedef struct {char bytes[12];} QUAD_ALIAS struct96;
+typedef struct {char bytes[20];} QUAD_ALIAS struct160;
+typedef struct {char bytes[24];} QUAD_ALIAS struct192;
+typedef struct {char bytes[32];} QUAD_ALIAS struct256;
+typedef struct {char bytes[48];} QUAD_ALIAS struct384;
+
+#define VAR struct96
+#define FUNC(NAME) NAME##96
+#include "quadsort.c"
+#undef VAR
+#undef FUNC
+
+#define VAR struct160
+#define FUNC(NAME) NAME##160
+#include "quadsort.c"
+#undef VAR
+#undef FUNC
+
+#define VAR struct192
+#define FUNC(NAME) NAME##192
+#include "quadsort.c"
+#undef VAR
+#undef FUNC
+
 #define VAR struct256
 #define FUNC(NAME) NAME##256
-
 #include "quadsort.c"
+#undef VAR
+#undef FUNC
 
+#define VAR struct384
+#define FUNC(NAME) NAME##384
+#include "quadsort.c"
 #undef VAR
 #undef FUNC
-*/
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 //┌─────────────────────────────────────────────────────────────────────────┐//
@@ -297,47 +858,993 @@ typedef struct {char bytes[32];} struct256;
 ///////////////////////////////////////////////////////////////////////////////
 
 
-void quadsort(void *array, size_t nmemb, size_t size, CMPFUNC *cmp)
+// Moves array[perm[index]] to array[index] by walking the cycles of the
+// permutation, using a single element of extra memory. A moved index is set
+// to its own position to mark it as done, so perm is destroyed.
+
+void quad_permute(void *array, size_t nmemb, size_t size, size_t *perm)
 {
-	if (nmemb < 2)
-	{
-		return;
-	}
+	char *pta = (char *) array, *tmp;
+	size_t index, cycle, next;
 
-	switch (size)
+	tmp = (char *) quad_malloc(size);
+
+	assert(tmp != NULL);
+
+	for (index = 0 ; index < nmemb ; index++)
 	{
-		case sizeof(char):
-			quadsort8(array, nmemb, cmp);
-			return;
+		if (perm[index] == index)
+		{
+			continue;
+		}
+		memcpy(tmp, pta + index * size, size);
 
-		case sizeof(short):
-			quadsort16(array, nmemb, cmp);
-			return;
+		cycle = index;
 
-		case sizeof(int):
-			quadsort32(array, nmemb, cmp);
-			return;
+		while (perm[cycle] != index)
+		{
+			next = perm[cycle];
 
-		case sizeof(long long):
-			quadsort64(array, nmemb, cmp);
-			return;
-#if (DBL_MANT_DIG < LDBL_MANT_DIG)
-		case sizeof(long double):
-			quadsort128(array, nmemb, cmp);
+			memcpy(pta + cycle * size, pta + next * size, size);
+
+			perm[cycle] = cycle;
+			cycle = next;
+		}
+		memcpy(pta + cycle * size, tmp, size);
+
+		perm[cycle] = cycle;
+	}
+	quad_free(tmp);
+}
+
+// sizes without an instantiation are sorted by sorting their indices, after
+// which the elements are permuted in place
+
+void quadsort_any(void *array, size_t nmemb, size_t size, CMPFUNC *cmp)
+{
+	size_t *perm = (size_t *) quad_malloc(nmemb * sizeof(size_t));
+
+	assert(perm != NULL);
+
+	quadsort_argsort_argsize(array, nmemb, size, cmp, perm);
+
+	quad_permute(array, nmemb, size, perm);
+
+	quad_free(perm);
+}
+// record sizes are dispatched separately, as they may overlap with the size
+// of a long double
+
+void quadsort_record(void *array, size_t nmemb, size_t size, CMPFUNC *cmp)
+{
+	switch (size)
+	{
+#ifndef cmp
+		case sizeof(struct96):
+			quadsort96(array, nmemb, cmp);
+			return;
+
+		case sizeof(struct160):
+			quadsort160(array, nmemb, cmp);
+			return;
+
+		case sizeof(struct192):
+			quadsort192(array, nmemb, cmp);
+			return;
+
+		case sizeof(struct256):
+			quadsort256(array, nmemb, cmp);
+			return;
+
+		case sizeof(struct384):
+			quadsort384(array, nmemb, cmp);
+			return;
+#endif
+		default:
+			quadsort_any(array, nmemb, size, cmp);
+	}
+}
+
+void quadsort(void *array, size_t nmemb, size_t size, CMPFUNC *cmp)
+{
+	if (nmemb < 2)
+	{
+		return;
+	}
+
+	switch (size)
+	{
+		case sizeof(char):
+			quadsort8(array, nmemb, cmp);
+			return;
+
+		case sizeof(short):
+			quadsort16(array, nmemb, cmp);
+			return;
+
+		case sizeof(int):
+			quadsort32(array, nmemb, cmp);
+			return;
+
+		case sizeof(long long):
+			quadsort64(array, nmemb, cmp);
+			return;
+#if (DBL_MANT_DIG < LDBL_MANT_DIG)
+		case sizeof(long double):
+			quadsort128(array, nmemb, cmp);
+			return;
+#endif
+
+		default:
+			quadsort_record(array, nmemb, size, cmp);
+	}
+}
+
+#ifdef QUADSORT_MT
+
+// Multithreaded quadsort, the output is identical to quadsort(). A threads
+// value of 0 uses one thread per online processor. Requires n swap memory,
+// if allocation fails it falls back to a single threaded quadsort(). Record
+// sizes are sorted single threaded.
+
+void quadsort_mt(void *array, size_t nmemb, size_t size, CMPFUNC *cmp, size_t threads)
+{
+	if (nmemb < 2)
+	{
+		return;
+	}
+
+	if (threads == 0)
+	{
+		long cpus = 1;
+
+#ifdef _SC_NPROCESSORS_ONLN
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		threads = cpus > 0 ? cpus : 1;
+	}
+
+	switch (size)
+	{
+		case sizeof(char):
+			quadsort_mt8(array, nmemb, cmp, threads);
+			return;
+
+		case sizeof(short):
+			quadsort_mt16(array, nmemb, cmp, threads);
+			return;
+
+		case sizeof(int):
+			quadsort_mt32(array, nmemb, cmp, threads);
+			return;
+
+		case sizeof(long long):
+			quadsort_mt64(array, nmemb, cmp, threads);
+			return;
+#if (DBL_MANT_DIG < LDBL_MANT_DIG)
+		case sizeof(long double):
+			quadsort_mt128(array, nmemb, cmp, threads);
+			return;
+#endif
+		default:
+			quadsort_record(array, nmemb, size, cmp);
+	}
+}
+
+#endif
+
+// A loser tree selects the smallest head of k sorted runs with log2(k)
+// comparisons per element. Runs are identified by index, head[run] points to
+// its current element or is NULL once the run is exhausted. Ties go to the
+// lower run, which keeps merges stable. After advancing head[tree[0]] call
+// quad_loser_replay() to find the next winner.
+
+typedef struct
+{
+	size_t k;
+	size_t *tree;
+	const char **head;
+	CMPFUNC *cmp;
+} QUADLOSER;
+
+int quad_loser_init(QUADLOSER *lt, size_t k, CMPFUNC *cmp)
+{
+	lt->k = k;
+	lt->cmp = cmp;
+	lt->tree = (size_t *) quad_malloc(k * 2 * sizeof(size_t));
+	lt->head = (const char **) quad_malloc(k * sizeof(char *));
+
+	if (lt->tree == NULL || lt->head == NULL)
+	{
+		quad_free(lt->tree);
+		quad_free(lt->head);
+
+		return 0;
+	}
+	memset(lt->head, 0, k * sizeof(char *));
+
+	return 1;
+}
+
+void quad_loser_free(QUADLOSER *lt)
+{
+	quad_free(lt->tree);
+	quad_free(lt->head);
+}
+
+// returns 1 if run a goes before run b
+
+int quad_loser_wins(QUADLOSER *lt, size_t a, size_t b)
+{
+	if (lt->head[b] == NULL)
+	{
+		return 1;
+	}
+	if (lt->head[a] == NULL)
+	{
+		return 0;
+	}
+	return a < b ? (lt->cmp)(lt->head[a], lt->head[b]) <= 0 : (lt->cmp)(lt->head[b], lt->head[a]) > 0;
+}
+
+// tree[1..k-1] holds the losers of the internal nodes, the leaf of a run is
+// at k + run. While building, tree[k + node] holds the winner of a node.
+
+void quad_loser_build(QUADLOSER *lt)
+{
+	size_t *tree = lt->tree, k = lt->k, node, a, b;
+
+	for (node = k - 1 ; node > 0 ; node--)
+	{
+		a = node * 2 >= k ? node * 2 - k : tree[k + node * 2];
+		b = node * 2 + 1 >= k ? node * 2 + 1 - k : tree[k + node * 2 + 1];
+
+		if (quad_loser_wins(lt, a, b))
+		{
+			tree[node] = b; tree[k + node] = a;
+		}
+		else
+		{
+			tree[node] = a; tree[k + node] = b;
+		}
+	}
+	tree[0] = k > 1 ? tree[k + 1] : 0;
+}
+
+void quad_loser_replay(QUADLOSER *lt)
+{
+	size_t *tree = lt->tree, winner = tree[0], node, swap;
+
+	for (node = (lt->k + winner) / 2 ; node > 0 ; node /= 2)
+	{
+		if (quad_loser_wins(lt, tree[node], winner))
+		{
+			swap = tree[node]; tree[node] = winner; winner = swap;
+		}
+	}
+	tree[0] = winner;
+}
+
+// merges k non-empty sorted runs into dest with a loser tree, returns 0 if
+// memory allocation failed
+
+int quad_loser_merge(void *dest, void **runs, size_t *len, size_t k, size_t size, CMPFUNC *cmp)
+{
+	char *ptd = (char *) dest;
+	const char **end;
+	QUADLOSER lt;
+	size_t run;
+
+	end = (const char **) quad_malloc(k * sizeof(char *));
+
+	if (end == NULL || quad_loser_init(&lt, k, cmp) == 0)
+	{
+		quad_free(end);
+
+		return 0;
+	}
+
+	for (run = 0 ; run < k ; run++)
+	{
+		lt.head[run] = (const char *) runs[run];
+		end[run] = lt.head[run] + len[run] * size;
+	}
+	quad_loser_build(&lt);
+
+	while (lt.head[lt.tree[0]])
+	{
+		run = lt.tree[0];
+
+		memcpy(ptd, lt.head[run], size);
+
+		ptd += size;
+		lt.head[run] += size;
+
+		if (lt.head[run] == end[run])
+		{
+			lt.head[run] = NULL;
+		}
+		quad_loser_replay(&lt);
+	}
+	quad_loser_free(&lt);
+	quad_free(end);
+
+	return 1;
+}
+
+// returns 0 if there is no instantiation for the element size
+
+int quad_merge_k(void *dest, void *swap, void **runs, size_t *len, size_t k, size_t size, CMPFUNC *cmp)
+{
+	switch (size)
+	{
+		case sizeof(char):
+			quad_merge_k8(dest, swap, runs, len, k, cmp);
+			return 1;
+
+		case sizeof(short):
+			quad_merge_k16(dest, swap, runs, len, k, cmp);
+			return 1;
+
+		case sizeof(int):
+			quad_merge_k32(dest, swap, runs, len, k, cmp);
+			return 1;
+
+		case sizeof(long long):
+			quad_merge_k64(dest, swap, runs, len, k, cmp);
+			return 1;
+#if (DBL_MANT_DIG < LDBL_MANT_DIG)
+		case sizeof(long double):
+			quad_merge_k128(dest, swap, runs, len, k, cmp);
+			return 1;
+#endif
+	}
+
+	switch (size)
+	{
+#ifndef cmp
+		case sizeof(struct96):
+			quad_merge_k96(dest, swap, runs, len, k, cmp);
+			return 1;
+
+		case sizeof(struct160):
+			quad_merge_k160(dest, swap, runs, len, k, cmp);
+			return 1;
+
+		case sizeof(struct192):
+			quad_merge_k192(dest, swap, runs, len, k, cmp);
+			return 1;
+
+		case sizeof(struct256):
+			quad_merge_k256(dest, swap, runs, len, k, cmp);
+			return 1;
+
+		case sizeof(struct384):
+			quad_merge_k384(dest, swap, runs, len, k, cmp);
+			return 1;
+#endif
+		default:
+			return 0;
+	}
+}
+
+// Stable merge of k sorted runs into dest, elements of equal runs keep the
+// order of the runs. The runs are merged with a tree of cross merges, which
+// requires n swap memory once there are more than two runs. Sizes without an
+// instantiation, or a failed swap allocation, use a loser tree instead. If
+// that fails too the runs are concatenated and sorted, with the same result.
+
+void quadsort_merge_k(const void **runs, const size_t *lens, size_t k, void *dest, size_t size, CMPFUNC *cmp)
+{
+	void **ptr, *swap = NULL;
+	size_t *len, run, cnt, nmemb;
+	int done = 0;
+
+	ptr = (void **) quad_malloc(k * sizeof(void *) + 1);
+	len = (size_t *) quad_malloc(k * sizeof(size_t) + 1);
+
+	for (run = cnt = nmemb = 0 ; ptr && len && run < k ; run++)
+	{
+		if (lens[run])
+		{
+			ptr[cnt] = (void *) runs[run];
+			len[cnt++] = lens[run];
+			nmemb += lens[run];
+		}
+	}
+
+	if (ptr && len)
+	{
+		if (cnt <= 1)
+		{
+			memcpy(dest, cnt ? ptr[0] : dest, nmemb * size);
+
+			done = 1;
+		}
+		else
+		{
+			swap = cnt > 2 ? quad_malloc(nmemb * size) : NULL;
+
+			if (cnt == 2 || swap)
+			{
+				done = quad_merge_k(dest, swap, ptr, len, cnt, size, cmp);
+			}
+			quad_free(swap);
+		}
+
+		if (done == 0)
+		{
+			done = quad_loser_merge(dest, ptr, len, cnt, size, cmp);
+		}
+	}
+	quad_free(len);
+	quad_free(ptr);
+
+	if (done == 0)
+	{
+		char *ptd = (char *) dest;
+
+		for (run = nmemb = 0 ; run < k ; run++)
+		{
+			memcpy(ptd + nmemb * size, runs[run], lens[run] * size);
+
+			nmemb += lens[run];
+		}
+		quadsort(dest, nmemb, size, cmp);
+	}
+}
+
+// Keeps an array sorted after appending elements to it. The first block
+// elements must be sorted, the unsorted tail up to nmemb is sorted and merged
+// into the prefix using swap memory the size of the tail. The result is the
+// same as a stable sort of the whole array. Element sizes without an
+// instantiation are sorted as a whole.
+
+void quadsort_append(void *array, size_t block, size_t nmemb, size_t size, CMPFUNC *cmp)
+{
+	if (block >= nmemb)
+	{
+		return;
+	}
+
+	switch (size)
+	{
+		case sizeof(char):
+			quadsort_append8(array, block, nmemb, cmp);
+			return;
+
+		case sizeof(short):
+			quadsort_append16(array, block, nmemb, cmp);
+			return;
+
+		case sizeof(int):
+			quadsort_append32(array, block, nmemb, cmp);
+			return;
+
+		case sizeof(long long):
+			quadsort_append64(array, block, nmemb, cmp);
+			return;
+#if (DBL_MANT_DIG < LDBL_MANT_DIG)
+		case sizeof(long double):
+			quadsort_append128(array, block, nmemb, cmp);
+			return;
+#endif
+	}
+
+	switch (size)
+	{
+#ifndef cmp
+		case sizeof(struct96):
+			quadsort_append96(array, block, nmemb, cmp);
+			return;
+
+		case sizeof(struct160):
+			quadsort_append160(array, block, nmemb, cmp);
+			return;
+
+		case sizeof(struct192):
+			quadsort_append192(array, block, nmemb, cmp);
+			return;
+
+		case sizeof(struct256):
+			quadsort_append256(array, block, nmemb, cmp);
+			return;
+
+		case sizeof(struct384):
+			quadsort_append384(array, block, nmemb, cmp);
+			return;
+#endif
+		default:
+			quadsort_any(array, nmemb, size, cmp);
+	}
+}
+
+// Stable partial sort, the k smallest elements end up sorted at the front of
+// the array while the order of the others is unspecified. Most elements are
+// rejected with one comparison against the k-th element, so the cost is
+// closer to n than to n log n for small k. Requires k swap memory. Element
+// sizes without an instantiation are sorted as a whole.
+
+void quadsort_partial(void *array, size_t nmemb, size_t k, size_t size, CMPFUNC *cmp)
+{
+	if (nmemb < 2)
+	{
+		return;
+	}
+
+	switch (size)
+	{
+		case sizeof(char):
+			quadsort_partial8(array, nmemb, k, cmp);
+			return;
+
+		case sizeof(short):
+			quadsort_partial16(array, nmemb, k, cmp);
+			return;
+
+		case sizeof(int):
+			quadsort_partial32(array, nmemb, k, cmp);
+			return;
+
+		case sizeof(long long):
+			quadsort_partial64(array, nmemb, k, cmp);
+			return;
+#if (DBL_MANT_DIG < LDBL_MANT_DIG)
+		case sizeof(long double):
+			quadsort_partial128(array, nmemb, k, cmp);
+			return;
+#endif
+	}
+
+	switch (size)
+	{
+#ifndef cmp
+		case sizeof(struct96):
+			quadsort_partial96(array, nmemb, k, cmp);
+			return;
+
+		case sizeof(struct160):
+			quadsort_partial160(array, nmemb, k, cmp);
+			return;
+
+		case sizeof(struct192):
+			quadsort_partial192(array, nmemb, k, cmp);
+			return;
+
+		case sizeof(struct256):
+			quadsort_partial256(array, nmemb, k, cmp);
+			return;
+
+		case sizeof(struct384):
+			quadsort_partial384(array, nmemb, k, cmp);
+			return;
+#endif
+		default:
+			quadsort_any(array, nmemb, size, cmp);
+	}
+}
+
+// Run adaptive sort, natural ascending and descending runs of any length are
+// found and merged in the order given by powersort, so an array made of r
+// sorted runs is sorted in about n log r time. Random data is slower than
+// with quadsort(). Requires n / 2 swap memory. Element sizes without an
+// instantiation are sorted with quadsort().
+
+void quadsort_natural(void *array, size_t nmemb, size_t size, CMPFUNC *cmp)
+{
+	if (nmemb < 2)
+	{
+		return;
+	}
+
+	switch (size)
+	{
+		case sizeof(char):
+			quadsort_natural8(array, nmemb, cmp);
+			return;
+
+		case sizeof(short):
+			quadsort_natural16(array, nmemb, cmp);
+			return;
+
+		case sizeof(int):
+			quadsort_natural32(array, nmemb, cmp);
+			return;
+
+		case sizeof(long long):
+			quadsort_natural64(array, nmemb, cmp);
+			return;
+#if (DBL_MANT_DIG < LDBL_MANT_DIG)
+		case sizeof(long double):
+			quadsort_natural128(array, nmemb, cmp);
+			return;
+#endif
+	}
+
+	switch (size)
+	{
+#ifndef cmp
+		case sizeof(struct96):
+			quadsort_natural96(array, nmemb, cmp);
+			return;
+
+		case sizeof(struct160):
+			quadsort_natural160(array, nmemb, cmp);
+			return;
+
+		case sizeof(struct192):
+			quadsort_natural192(array, nmemb, cmp);
+			return;
+
+		case sizeof(struct256):
+			quadsort_natural256(array, nmemb, cmp);
+			return;
+
+		case sizeof(struct384):
+			quadsort_natural384(array, nmemb, cmp);
+			return;
+#endif
+		default:
+			quadsort_any(array, nmemb, size, cmp);
+	}
+}
+
+// A sort context owns a swap buffer that is reused and grown across calls,
+// so sorting many arrays doesn't allocate memory in steady state.
+
+typedef struct quadsort_ctx QUADCTX;
+
+struct quadsort_ctx
+{
+	void *swap;
+	size_t bytes;
+};
+
+QUADCTX *quadsort_ctx_new(void)
+{
+	QUADCTX *ctx = (QUADCTX *) quad_malloc(sizeof(QUADCTX));
+
+	if (ctx)
+	{
+		ctx->swap = NULL;
+		ctx->bytes = 0;
+	}
+	return ctx;
+}
+
+void quadsort_ctx_free(QUADCTX *ctx)
+{
+	if (ctx)
+	{
+		quad_free(ctx->swap);
+		quad_free(ctx);
+	}
+}
+
+// the number of workspace bytes needed to sort nmemb elements of size bytes
+
+size_t quadsort_ctx_bytes(size_t nmemb, size_t size)
+{
+	return quad_swap_size(nmemb) * size;
+}
+
+// grows the workspace to at least bytes, returns 0 if allocation failed, in
+// which case the previous workspace is kept
+
+int quadsort_ctx_reserve(QUADCTX *ctx, size_t bytes)
+{
+	void *swap;
+
+	if (bytes <= ctx->bytes)
+	{
+		return 1;
+	}
+	swap = quad_malloc(bytes);
+
+	if (swap == NULL)
+	{
+		return 0;
+	}
+	quad_free(ctx->swap);
+
+	ctx->swap = swap;
+	ctx->bytes = bytes;
+
+	return 1;
+}
+
+// dispatches like quadsort(), if the workspace can't be grown it falls back
+// to quadsort(), as do element sizes without an instantiation
+
+void quadsort_ctx_sort(QUADCTX *ctx, void *array, size_t nmemb, size_t size, CMPFUNC *cmp)
+{
+	size_t swap_size;
+
+	if (nmemb < 2)
+	{
+		return;
+	}
+
+	if (quadsort_ctx_reserve(ctx, quadsort_ctx_bytes(nmemb, size)) == 0)
+	{
+		quadsort(array, nmemb, size, cmp);
+		return;
+	}
+	swap_size = ctx->bytes / size;
+
+	switch (size)
+	{
+		case sizeof(char):
+			quadsort_swap8(array, ctx->swap, swap_size, nmemb, cmp);
 			return;
-#endif
-//		case sizeof(struct256):
-//			quadsort256(array, nmemb, cmp);
-//			return;
 
-		default:
+		case sizeof(short):
+			quadsort_swap16(array, ctx->swap, swap_size, nmemb, cmp);
+			return;
+
+		case sizeof(int):
+			quadsort_swap32(array, ctx->swap, swap_size, nmemb, cmp);
+			return;
+
+		case sizeof(long long):
+			quadsort_swap64(array, ctx->swap, swap_size, nmemb, cmp);
+			return;
 #if (DBL_MANT_DIG < LDBL_MANT_DIG)
-			assert(size == sizeof(char) || size == sizeof(short) || size == sizeof(int) || size == sizeof(long long) || size == sizeof(long double));
-#else
-			assert(size == sizeof(char) || size == sizeof(short) || size == sizeof(int) || size == sizeof(long long));
+		case sizeof(long double):
+			quadsort_swap128(array, ctx->swap, swap_size, nmemb, cmp);
+			return;
+#endif
+	}
+
+	switch (size)
+	{
+#ifndef cmp
+		case sizeof(struct96):
+			quadsort_swap96(array, ctx->swap, swap_size, nmemb, cmp);
+			return;
+
+		case sizeof(struct160):
+			quadsort_swap160(array, ctx->swap, swap_size, nmemb, cmp);
+			return;
+
+		case sizeof(struct192):
+			quadsort_swap192(array, ctx->swap, swap_size, nmemb, cmp);
+			return;
+
+		case sizeof(struct256):
+			quadsort_swap256(array, ctx->swap, swap_size, nmemb, cmp);
+			return;
+
+		case sizeof(struct384):
+			quadsort_swap384(array, ctx->swap, swap_size, nmemb, cmp);
+			return;
 #endif
-//			qsort(array, nmemb, size, cmp);
+		default:
+			quadsort_any(array, nmemb, size, cmp);
+	}
+}
+
+// Floats and doubles are sorted in IEEE 754 totalOrder by transforming them
+// in place into signed integers with the same order, the transform is its own
+// inverse. This gives -NaN < -inf < -1.0 < -0.0 < +0.0 < 1.0 < +inf < +NaN,
+// with NaNs ordered by payload. The bits are accessed with memcpy() to stay
+// clear of strict aliasing.
+
+void quad_float_order32(void *array, size_t nmemb)
+{
+	char *pta = (char *) array;
+	int bits;
+
+	while (nmemb--)
+	{
+		memcpy(&bits, pta, sizeof(int));
+		bits ^= (bits >> 31) & 0x7FFFFFFF;
+		memcpy(pta, &bits, sizeof(int));
+
+		pta += sizeof(int);
+	}
+}
+
+void quad_float_order64(void *array, size_t nmemb)
+{
+	char *pta = (char *) array;
+	long long bits;
+
+	while (nmemb--)
+	{
+		memcpy(&bits, pta, sizeof(long long));
+		bits ^= (bits >> 63) & 0x7FFFFFFFFFFFFFFFLL;
+		memcpy(pta, &bits, sizeof(long long));
+
+		pta += sizeof(long long);
+	}
+}
+
+// quadsort_prim() uses a stable LSD radix sort for large arrays of random
+// integers. A sample of the array is checked first, presorted arrays are left
+// to quadsort as quad_swap() and the merges do better on those. The entropy
+// is estimated by the number of bytes that vary within the sample, as every
+// varying byte costs a radix pass. Signed integers are biased to sort unsigned.
+
+#define QUAD_RADIX_MIN 262144
+
+int quad_radix_pick(unsigned long long *sample, size_t ordered, size_t passes)
+{
+	unsigned long long diff = 0;
+	size_t cnt;
+
+	if (ordered < 48 || ordered > 144)
+	{
+		return 0;
+	}
+
+	for (cnt = 1 ; cnt < 192 ; cnt++)
+	{
+		diff |= sample[0] ^ sample[cnt];
+	}
+
+	for (cnt = 0 ; diff ; diff >>= 8)
+	{
+		cnt += (diff & 255) != 0;
+	}
+	return cnt <= passes;
+}
+
+// 64 windows of 4 elements spread over the array, giving 192 pairs
+
+int quad_radix_sample32(unsigned int *array, size_t nmemb, unsigned int bias)
+{
+	unsigned long long sample[192];
+	size_t cnt, idx, ordered = 0;
+	unsigned int *pta;
+
+	for (cnt = idx = 0 ; cnt < 64 ; cnt++)
+	{
+		pta = array + (nmemb - 4) / 63 * cnt;
+
+		ordered += (pta[0] ^ bias) <= (pta[1] ^ bias);
+		ordered += (pta[1] ^ bias) <= (pta[2] ^ bias);
+		ordered += (pta[2] ^ bias) <= (pta[3] ^ bias);
+
+		sample[idx++] = pta[0]; sample[idx++] = pta[1]; sample[idx++] = pta[2];
+	}
+	return quad_radix_pick(sample, ordered, 4);
+}
+
+// 64 bit keys need up to 8 passes, beyond 5 the merges are faster
+
+int quad_radix_sample64(unsigned long long *array, size_t nmemb, unsigned long long bias)
+{
+	unsigned long long sample[192];
+	size_t cnt, idx, ordered = 0;
+	unsigned long long *pta;
+
+	for (cnt = idx = 0 ; cnt < 64 ; cnt++)
+	{
+		pta = array + (nmemb - 4) / 63 * cnt;
+
+		ordered += (pta[0] ^ bias) <= (pta[1] ^ bias);
+		ordered += (pta[1] ^ bias) <= (pta[2] ^ bias);
+		ordered += (pta[2] ^ bias) <= (pta[3] ^ bias);
+
+		sample[idx++] = pta[0]; sample[idx++] = pta[1]; sample[idx++] = pta[2];
+	}
+	return quad_radix_pick(sample, ordered, 5);
+}
+
+// returns 0 if the array was left for quadsort, passes where every element
+// has the same digit are skipped
+
+int quad_radix32(void *array, size_t nmemb, unsigned int bias)
+{
+	unsigned int *pta = (unsigned int *) array, *pts, *ptt, *swap, key;
+	size_t count[4][256], offset, sum, cnt, pass;
+
+	if (nmemb < QUAD_RADIX_MIN || quad_radix_sample32(pta, nmemb, bias) == 0)
+	{
+		return 0;
+	}
+	swap = (unsigned int *) quad_malloc(nmemb * sizeof(unsigned int));
+
+	if (swap == NULL)
+	{
+		return 0;
+	}
+	memset(count, 0, sizeof(count));
+
+	for (cnt = 0 ; cnt < nmemb ; cnt++)
+	{
+		key = pta[cnt] ^ bias;
+
+		count[0][key & 255]++;
+		count[1][key >> 8 & 255]++;
+		count[2][key >> 16 & 255]++;
+		count[3][key >> 24]++;
+	}
+	pts = swap;
+
+	for (pass = 0 ; pass < 4 ; pass++)
+	{
+		if (count[pass][(pta[0] ^ bias) >> (pass * 8) & 255] == nmemb)
+		{
+			continue;
+		}
+
+		for (cnt = sum = 0 ; cnt < 256 ; cnt++)
+		{
+			offset = count[pass][cnt]; count[pass][cnt] = sum; sum += offset;
+		}
+
+		for (cnt = 0 ; cnt < nmemb ; cnt++)
+		{
+			pts[count[pass][(pta[cnt] ^ bias) >> (pass * 8) & 255]++] = pta[cnt];
+		}
+		ptt = pta; pta = pts; pts = ptt;
+	}
+
+	if (pta != array)
+	{
+		memcpy(array, pta, nmemb * sizeof(unsigned int));
+	}
+	quad_free(swap);
+
+	return 1;
+}
+
+int quad_radix64(void *array, size_t nmemb, unsigned long long bias)
+{
+	unsigned long long *pta = (unsigned long long *) array, *pts, *ptt, *swap, key;
+	size_t count[8][256], offset, sum, cnt, pass;
+
+	if (nmemb < QUAD_RADIX_MIN || quad_radix_sample64(pta, nmemb, bias) == 0)
+	{
+		return 0;
+	}
+	swap = (unsigned long long *) quad_malloc(nmemb * sizeof(unsigned long long));
+
+	if (swap == NULL)
+	{
+		return 0;
+	}
+	memset(count, 0, sizeof(count));
+
+	for (cnt = 0 ; cnt < nmemb ; cnt++)
+	{
+		key = pta[cnt] ^ bias;
+
+		for (pass = 0 ; pass < 8 ; pass++)
+		{
+			count[pass][key >> (pass * 8) & 255]++;
+		}
+	}
+	pts = swap;
+
+	for (pass = 0 ; pass < 8 ; pass++)
+	{
+		if (count[pass][(pta[0] ^ bias) >> (pass * 8) & 255] == nmemb)
+		{
+			continue;
+		}
+
+		for (cnt = sum = 0 ; cnt < 256 ; cnt++)
+		{
+			offset = count[pass][cnt]; count[pass][cnt] = sum; sum += offset;
+		}
+
+		for (cnt = 0 ; cnt < nmemb ; cnt++)
+		{
+			pts[count[pass][(pta[cnt] ^ bias) >> (pass * 8) & 255]++] = pta[cnt];
+		}
+		ptt = pta; pta = pts; pts = ptt;
+	}
+
+	if (pta != array)
+	{
+		memcpy(array, pta, nmemb * sizeof(unsigned long long));
 	}
+	quad_free(swap);
+
+	return 1;
 }
 
 // suggested size values for primitives:
@@ -364,36 +1871,197 @@ void quadsort_prim(void *array, size_t nmemb, size_t size)
 	switch (size)
 	{
 		case 4:
-			quadsort_int32(array, nmemb, NULL);
+			if (quad_radix32(array, nmemb, 0x80000000) == 0)
+			{
+				quadsort_int32(array, nmemb, NULL);
+			}
+			return;
+		case 5:
+			if (quad_radix32(array, nmemb, 0) == 0)
+			{
+				quadsort_uint32(array, nmemb, NULL);
+			}
+			return;
+		case 6:
+			quad_float_order32(array, nmemb);
+			if (quad_radix32(array, nmemb, 0x80000000) == 0)
+			{
+				quadsort_int32(array, nmemb, NULL);
+			}
+			quad_float_order32(array, nmemb);
+			return;
+		case 7:
+			quad_float_order64(array, nmemb);
+			if (quad_radix64(array, nmemb, 0x8000000000000000ULL) == 0)
+			{
+				quadsort_int64(array, nmemb, NULL);
+			}
+			quad_float_order64(array, nmemb);
+			return;
+		case 8:
+			if (quad_radix64(array, nmemb, 0x8000000000000000ULL) == 0)
+			{
+				quadsort_int64(array, nmemb, NULL);
+			}
+			return;
+		case 9:
+			if (quad_radix64(array, nmemb, 0) == 0)
+			{
+				quadsort_uint64(array, nmemb, NULL);
+			}
+			return;
+		default:
+			assert(size >= 4 && size <= 9);
+			return;
+	}
+}
+
+// Stable sort of a key array that moves a parallel array of values along,
+// key_type uses the quadsort_prim() numbering and value_size is 4 or 8 bytes.
+// Requires 2n pair memory.
+
+void quadsort_kv(void *keys, void *values, size_t nmemb, size_t key_type, size_t value_size)
+{
+	if (nmemb < 2)
+	{
+		return;
+	}
+
+	switch (key_type)
+	{
+		case 6:
+			quad_float_order32(keys, nmemb);
+			quadsort_kv(keys, values, nmemb, 4, value_size);
+			quad_float_order32(keys, nmemb);
+			return;
+		case 7:
+			quad_float_order64(keys, nmemb);
+			quadsort_kv(keys, values, nmemb, 8, value_size);
+			quad_float_order64(keys, nmemb);
+			return;
+	}
+
+	switch (value_size)
+	{
+		case sizeof(int):
+			switch (key_type)
+			{
+				case 4:
+					quadsort_kv_int32_32(keys, values, nmemb);
+					return;
+				case 5:
+					quadsort_kv_uint32_32(keys, values, nmemb);
+					return;
+				case 8:
+					quadsort_kv_int64_32(keys, values, nmemb);
+					return;
+				case 9:
+					quadsort_kv_uint64_32(keys, values, nmemb);
+					return;
+			}
+			break;
+
+		case sizeof(long long):
+			switch (key_type)
+			{
+				case 4:
+					quadsort_kv_int32_64(keys, values, nmemb);
+					return;
+				case 5:
+					quadsort_kv_uint32_64(keys, values, nmemb);
+					return;
+				case 8:
+					quadsort_kv_int64_64(keys, values, nmemb);
+					return;
+				case 9:
+					quadsort_kv_uint64_64(keys, values, nmemb);
+					return;
+			}
+			break;
+	}
+	assert(key_type >= 4 && key_type <= 9 && (value_size == sizeof(int) || value_size == sizeof(long long)));
+}
+
+// Stable argsort, perm receives the indices of the elements in sorted order
+// while the array itself is left untouched. The comparison function receives
+// pointers to the elements, like qsort(). The 32 bit variant halves the
+// memory traffic and is limited to arrays below 4G elements.
+
+void quadsort_argsort(const void *array, size_t nmemb, size_t size, CMPFUNC *cmp, size_t *perm)
+{
+	quadsort_argsort_argsize(array, nmemb, size, cmp, perm);
+}
+
+void quadsort_argsort32(const void *array, size_t nmemb, size_t size, CMPFUNC *cmp, unsigned int *perm)
+{
+	assert(nmemb <= (unsigned int) -1);
+
+	quadsort_argsort_arg32(array, nmemb, size, cmp, perm);
+}
+
+// key_type uses the quadsort_prim() numbering, the keys are sorted by value
+// together with their index, requiring 2n pair memory.
+
+void quadsort_argsort_prim(const void *array, size_t nmemb, size_t key_type, size_t *perm)
+{
+	switch (key_type)
+	{
+		case 4:
+			quadsort_argsort_int32_64(array, nmemb, perm);
+			return;
+		case 5:
+			quadsort_argsort_uint32_64(array, nmemb, perm);
+			return;
+		case 8:
+			quadsort_argsort_int64_64(array, nmemb, perm);
+			return;
+		case 9:
+			quadsort_argsort_uint64_64(array, nmemb, perm);
+			return;
+		default:
+			assert(key_type == 4 || key_type == 5 || key_type == 8 || key_type == 9);
+			return;
+	}
+}
+
+void quadsort_argsort_prim32(const void *array, size_t nmemb, size_t key_type, unsigned int *perm)
+{
+	assert(nmemb <= (unsigned int) -1);
+
+	switch (key_type)
+	{
+		case 4:
+			quadsort_argsort_int32_32(array, nmemb, perm);
 			return;
 		case 5:
-			quadsort_uint32(array, nmemb, NULL);
+			quadsort_argsort_uint32_32(array, nmemb, perm);
 			return;
 		case 8:
-			quadsort_int64(array, nmemb, NULL);
+			quadsort_argsort_int64_32(array, nmemb, perm);
 			return;
 		case 9:
-			quadsort_uint64(array, nmemb, NULL);
+			quadsort_argsort_uint64_32(array, nmemb, perm);
 			return;
 		default:
-			assert(size == sizeof(int) || size == sizeof(int) + 1 || size == sizeof(long long) || size == sizeof(long long) + 1);
+			assert(key_type == 4 || key_type == 5 || key_type == 8 || key_type == 9);
 			return;
 	}
 }
 
 // Sort arrays of structures, the comparison function must be by reference.
+// The sorted pointers are applied in place with quad_permute().
 
 void quadsort_size(void *array, size_t nmemb, size_t size, CMPFUNC *cmp)
 {
-	char **pti, *pta, *pts;
-	size_t index, offset;
+	char **pti, *pta;
+	size_t *ptx, index, offset;
 
 	if (nmemb < 2)
 	{
 		return;
 	}
 	pta = (char *) array;
-	pti = (char **) malloc(nmemb * sizeof(char *));
+	pti = (char **) quad_malloc(nmemb * sizeof(char *));
 
 	assert(pti != NULL);
 
@@ -410,22 +2078,170 @@ void quadsort_size(void *array, size_t nmemb, size_t size, CMPFUNC *cmp)
 		case 8: quadsort64(pti, nmemb, cmp); break;
 	}
 
-	pts = (char *) malloc(nmemb * size);
+	// the pointers are turned into indices to apply them in place
+
+	ptx = (size_t *) pti;
 
-	assert(pts != NULL);
-	
 	for (index = 0 ; index < nmemb ; index++)
 	{
-		memcpy(pts, pti[index], size);
+		ptx[index] = (pti[index] - pta) / size;
+	}
+	quad_permute(array, nmemb, size, ptx);
+
+	quad_free(pti);
+}
+
+// Stable selection, afterwards the element at each rank is the one a stable
+// sort would put there, with smaller or equal elements before it and larger
+// or equal elements after it. Ranks of nmemb or above are ignored. Requires n
+// swap memory, element sizes without an instantiation are sorted as a whole.
+
+size_t *quad_sorted_ranks(const size_t *ranks, size_t m, size_t nmemb, size_t *count)
+{
+	size_t *sorted, cnt;
+
+	sorted = (size_t *) quad_malloc(m * sizeof(size_t) + 1);
+
+	if (sorted == NULL)
+	{
+		return NULL;
+	}
+
+	for (cnt = *count = 0 ; cnt < m ; cnt++)
+	{
+		if (ranks[cnt] < nmemb)
+		{
+			sorted[(*count)++] = ranks[cnt];
+		}
+	}
+	quadsort_prim(sorted, *count, sizeof(size_t) == 8 ? 9 : 5);
+
+	return sorted;
+}
+
+// returns 0 if there is no instantiation for size
+
+int quad_select(void *array, size_t nmemb, size_t *ranks, size_t m, size_t size, CMPFUNC *cmp)
+{
+	switch (size)
+	{
+		case sizeof(char):
+			quadsort_select8(array, nmemb, ranks, m, cmp);
+			return 1;
+
+		case sizeof(short):
+			quadsort_select16(array, nmemb, ranks, m, cmp);
+			return 1;
+
+		case sizeof(int):
+			quadsort_select32(array, nmemb, ranks, m, cmp);
+			return 1;
+
+		case sizeof(long long):
+			quadsort_select64(array, nmemb, ranks, m, cmp);
+			return 1;
+#if (DBL_MANT_DIG < LDBL_MANT_DIG)
+		case sizeof(long double):
+			quadsort_select128(array, nmemb, ranks, m, cmp);
+			return 1;
+#endif
+	}
+
+	switch (size)
+	{
+#ifndef cmp
+		case sizeof(struct96):
+			quadsort_select96(array, nmemb, ranks, m, cmp);
+			return 1;
+
+		case sizeof(struct160):
+			quadsort_select160(array, nmemb, ranks, m, cmp);
+			return 1;
+
+		case sizeof(struct192):
+			quadsort_select192(array, nmemb, ranks, m, cmp);
+			return 1;
+
+		case sizeof(struct256):
+			quadsort_select256(array, nmemb, ranks, m, cmp);
+			return 1;
+
+		case sizeof(struct384):
+			quadsort_select384(array, nmemb, ranks, m, cmp);
+			return 1;
+#endif
+		default:
+			return 0;
+	}
+}
+
+void quadsort_quantiles(void *array, size_t nmemb, const size_t *ranks, size_t m, size_t size, CMPFUNC *cmp)
+{
+	size_t *sorted, count;
+
+	sorted = quad_sorted_ranks(ranks, m, nmemb, &count);
+
+	if (sorted == NULL)
+	{
+		quadsort(array, nmemb, size, cmp);
+		return;
+	}
 
-		pts += size;
+	if (quad_select(array, nmemb, sorted, count, size, cmp) == 0)
+	{
+		quadsort(array, nmemb, size, cmp);
 	}
-	pts -= nmemb * size;
+	quad_free(sorted);
+}
+
+void quadsort_select(void *array, size_t nmemb, size_t n, size_t size, CMPFUNC *cmp)
+{
+	quadsort_quantiles(array, nmemb, &n, 1, size, cmp);
+}
+
+// key_type uses the quadsort_prim() numbering, floats and doubles are
+// selected in totalOrder
+
+void quadsort_quantiles_prim(void *array, size_t nmemb, const size_t *ranks, size_t m, size_t key_type)
+{
+	size_t *sorted, count;
+
+	sorted = quad_sorted_ranks(ranks, m, nmemb, &count);
 
-	memcpy(array, pts, nmemb * size);
+	if (sorted == NULL)
+	{
+		quadsort_prim(array, nmemb, key_type);
+		return;
+	}
 
-	free(pti);
-	free(pts);
+	switch (key_type)
+	{
+		case 4:
+			quadsort_select_int32(array, nmemb, sorted, count, NULL);
+			break;
+		case 5:
+			quadsort_select_uint32(array, nmemb, sorted, count, NULL);
+			break;
+		case 6:
+			quad_float_order32(array, nmemb);
+			quadsort_select_int32(array, nmemb, sorted, count, NULL);
+			quad_float_order32(array, nmemb);
+			break;
+		case 7:
+			quad_float_order64(array, nmemb);
+			quadsort_select_int64(array, nmemb, sorted, count, NULL);
+			quad_float_order64(array, nmemb);
+			break;
+		case 8:
+			quadsort_select_int64(array, nmemb, sorted, count, NULL);
+			break;
+		case 9:
+			quadsort_select_uint64(array, nmemb, sorted, count, NULL);
+			break;
+		default:
+			assert(key_type >= 4 && key_type <= 9);
+	}
+	quad_free(sorted);
 }
 
 #undef QUAD_CACHE
@@ -0,0 +1,174 @@
+// quadsort.hpp - C++ front end for quadsort with inlined comparisons
+
+#ifndef QUADSORT_HPP
+#define QUADSORT_HPP
+
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "quadsort.h"
+
+// quadsort.c is instantiated as the members of a class template, with VAR as
+// the element type and CMPFUNC as the type of a comparator object. The cmp
+// macro calls the comparator through a pointer whose type is known, so the
+// comparison is inlined like it is with the primitive cmp macro.
+
+template<class VAR, class CMPFUNC>
+struct quad_sorter
+{
+#pragma push_macro("cmp")
+#undef cmp
+#define cmp(a,b) (*cmp)(a, b)
+#define FUNC(NAME) NAME
+#define QUAD_CPP
+
+#include "quadsort.c"
+
+#undef QUAD_CPP
+#undef FUNC
+#undef cmp
+#pragma pop_macro("cmp")
+};
+
+// quadsort compares with a > b, which for a less than comparator is b < a
+
+template<class T, class Compare>
+struct quad_less
+{
+	Compare comp;
+
+	quad_less(Compare comp) : comp(comp) {}
+
+	int operator()(const T *a, const T *b)
+	{
+		return comp(*b, *a);
+	}
+};
+
+template<class RandomIt, class Compare>
+struct quad_index_less
+{
+	RandomIt first;
+	Compare comp;
+
+	quad_index_less(RandomIt first, Compare comp) : first(first), comp(comp) {}
+
+	int operator()(const size_t *a, const size_t *b)
+	{
+		return comp(first[*b], first[*a]);
+	}
+};
+
+// Elements are sorted in place when the iterator refers to contiguous memory
+// and the element is trivially copyable and trivially default constructible,
+// as quadsort.c copies elements with memcpy and declares arrays of VAR for
+// swap memory. Elements of up to 48 bytes are moved directly, like the
+// record sizes of quadsort(), larger elements and other iterators are sorted
+// by sorting their indices, after which the elements are moved in place like
+// quad_permute() does.
+
+template<class RandomIt, class T = typename std::iterator_traits<RandomIt>::value_type>
+struct quad_contiguous : std::integral_constant<bool,
+#if defined __cpp_lib_concepts
+	std::contiguous_iterator<RandomIt> ||
+#endif
+	std::is_pointer<RandomIt>::value ||
+	(std::is_same<RandomIt, typename std::vector<T>::iterator>::value && !std::is_same<T, bool>::value)> {};
+
+template<class RandomIt, class T = typename std::iterator_traits<RandomIt>::value_type>
+struct quad_direct : std::integral_constant<bool, quad_contiguous<RandomIt>::value && std::is_trivially_copyable<T>::value && std::is_trivially_default_constructible<T>::value && sizeof(T) <= 48> {};
+
+struct quadsort
+{
+	template<class RandomIt, class Compare>
+	static void stable_sort(RandomIt first, RandomIt last, Compare comp)
+	{
+		size_t nmemb = last - first;
+
+		if (nmemb < 2)
+		{
+			return;
+		}
+		sort_dispatch(first, nmemb, comp, quad_direct<RandomIt>());
+	}
+
+	template<class RandomIt>
+	static void stable_sort(RandomIt first, RandomIt last)
+	{
+		stable_sort(first, last, std::less<typename std::iterator_traits<RandomIt>::value_type>());
+	}
+
+	// quadsort is stable, so sort() is the same as stable_sort()
+
+	template<class RandomIt, class Compare>
+	static void sort(RandomIt first, RandomIt last, Compare comp)
+	{
+		stable_sort(first, last, comp);
+	}
+
+	template<class RandomIt>
+	static void sort(RandomIt first, RandomIt last)
+	{
+		stable_sort(first, last);
+	}
+
+	template<class RandomIt, class Compare>
+	static void sort_dispatch(RandomIt first, size_t nmemb, Compare comp, std::true_type)
+	{
+		typedef typename std::iterator_traits<RandomIt>::value_type T;
+
+		quad_less<T, Compare> less(comp);
+		quad_sorter<T, quad_less<T, Compare> > sorter;
+
+		sorter.quadsort(&*first, nmemb, &less);
+	}
+
+	template<class RandomIt, class Compare>
+	static void sort_dispatch(RandomIt first, size_t nmemb, Compare comp, std::false_type)
+	{
+		typedef typename std::iterator_traits<RandomIt>::value_type T;
+
+		quad_index_less<RandomIt, Compare> less(first, comp);
+		quad_sorter<size_t, quad_index_less<RandomIt, Compare> > sorter;
+		size_t *perm = (size_t *) quad_malloc(nmemb * sizeof(size_t));
+		size_t index, cycle, next;
+
+		assert(perm != NULL);
+
+		for (index = 0 ; index < nmemb ; index++)
+		{
+			perm[index] = index;
+		}
+		sorter.quadsort(perm, nmemb, &less);
+
+		for (index = 0 ; index < nmemb ; index++)
+		{
+			if (perm[index] == index)
+			{
+				continue;
+			}
+			T tmp(std::move(first[index]));
+
+			cycle = index;
+
+			while (perm[cycle] != index)
+			{
+				next = perm[cycle];
+
+				first[cycle] = std::move(first[next]);
+
+				perm[cycle] = cycle;
+				cycle = next;
+			}
+			first[cycle] = std::move(tmp);
+
+			perm[cycle] = cycle;
+		}
+		quad_free(perm);
+	}
+};
+
+#endif
@@ -0,0 +1,755 @@
+// quadsort_ext 1.0 - External sorting of binary files larger than memory
+
+#ifndef QUADSORT_EXT_H
+#define QUADSORT_EXT_H
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "quadsort.h"
+
+// A file of fixed size records is sorted in chunks that fit the memory
+// budget. Each chunk is sorted and spilled as a run to a temporary file in
+// $TMPDIR, after which the runs are merged with a loser tree. A background
+// thread reads the next chunk and writes the previous run while the current
+// chunk is being sorted. While merging each run reads ahead into its second
+// buffer in the background, and the merged output is written in the
+// background as well.
+//
+// The chunk phase uses four chunks of memory, three I/O buffers and the swap
+// memory of the sort. The merge phase gives half the budget to the two
+// buffers of each run and half to the two output buffers. The runs are merged
+// in a single pass, so each run buffer holds at least one record.
+
+typedef struct
+{
+	pthread_t thread;
+	int busy;
+	int fd;
+	int write;
+	char *buffer;
+	size_t bytes;
+	off_t offset;
+	size_t result;
+	int error;
+} QUADIO;
+
+// transfers bytes at offset, stops early at the end of the file when reading
+
+size_t quad_io_transfer(QUADIO *io)
+{
+	size_t done = 0;
+	ssize_t cnt;
+
+	while (done < io->bytes)
+	{
+		if (io->write)
+		{
+			cnt = pwrite(io->fd, io->buffer + done, io->bytes - done, io->offset + done);
+		}
+		else
+		{
+			cnt = pread(io->fd, io->buffer + done, io->bytes - done, io->offset + done);
+		}
+
+		if (cnt < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			io->error = errno;
+			break;
+		}
+		if (cnt == 0)
+		{
+			break;
+		}
+		done += cnt;
+	}
+	return done;
+}
+
+void *quad_io_thread(void *arg)
+{
+	QUADIO *io = (QUADIO *) arg;
+
+	io->result = quad_io_transfer(io);
+
+	return NULL;
+}
+
+// returns the number of bytes transferred by the last request
+
+size_t quad_io_finish(QUADIO *io)
+{
+	if (io->busy)
+	{
+		pthread_join(io->thread, NULL);
+
+		io->busy = 0;
+	}
+	return io->result;
+}
+
+// starts a request in the background, if no thread can be created the
+// request is carried out before returning
+
+void quad_io_start(QUADIO *io, int fd, int write, void *buffer, size_t bytes, off_t offset)
+{
+	quad_io_finish(io);
+
+	io->fd = fd;
+	io->write = write;
+	io->buffer = (char *) buffer;
+	io->bytes = bytes;
+	io->offset = offset;
+	io->result = 0;
+
+	if (pthread_create(&io->thread, NULL, quad_io_thread, io) == 0)
+	{
+		io->busy = 1;
+	}
+	else
+	{
+		io->result = quad_io_transfer(io);
+	}
+}
+
+// opens an anonymous temporary file, it is removed when closed
+
+int quad_ext_tmpfile(void)
+{
+	const char *dir = getenv("TMPDIR");
+	char *path;
+	int fd;
+
+	if (dir == NULL || *dir == 0)
+	{
+		dir = "/tmp";
+	}
+	path = (char *) quad_malloc(strlen(dir) + 20);
+
+	if (path == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+	sprintf(path, "%s/quadsort.XXXXXX", dir);
+
+	fd = mkstemp(path);
+
+	if (fd != -1)
+	{
+		unlink(path);
+	}
+	quad_free(path);
+
+	return fd;
+}
+
+// comparison functions for merging runs of primitives, floats and doubles
+// are merged while in their totalOrder integer form
+
+int quad_ext_cmp_int32(const void *a, const void *b)
+{
+	return *(const int *) a > *(const int *) b;
+}
+
+int quad_ext_cmp_uint32(const void *a, const void *b)
+{
+	return *(const unsigned int *) a > *(const unsigned int *) b;
+}
+
+int quad_ext_cmp_int64(const void *a, const void *b)
+{
+	return *(const long long *) a > *(const long long *) b;
+}
+
+int quad_ext_cmp_uint64(const void *a, const void *b)
+{
+	return *(const unsigned long long *) a > *(const unsigned long long *) b;
+}
+
+void quad_ext_sort(void *array, size_t nmemb, size_t size, CMPFUNC *cmp, size_t prim)
+{
+	if (cmp)
+	{
+		quadsort(array, nmemb, size, cmp);
+	}
+	else if (prim == 6)
+	{
+		quad_float_order32(array, nmemb);
+		quadsort_prim(array, nmemb, 4);
+	}
+	else if (prim == 7)
+	{
+		quad_float_order64(array, nmemb);
+		quadsort_prim(array, nmemb, 8);
+	}
+	else
+	{
+		quadsort_prim(array, nmemb, prim);
+	}
+}
+
+// undoes the float transform of sorted runs before they are written out
+
+void quad_ext_output(void *array, size_t nmemb, CMPFUNC *cmp, size_t prim)
+{
+	if (cmp == NULL && prim == 6)
+	{
+		quad_float_order32(array, nmemb);
+	}
+	else if (cmp == NULL && prim == 7)
+	{
+		quad_float_order64(array, nmemb);
+	}
+}
+
+// While merging, one I/O thread reads ahead for every run. Each run has a
+// request of its own, which is queued in the order the runs run dry, busy
+// is set while a request is queued or being read.
+
+typedef struct
+{
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	QUADIO *io;
+	size_t *queue;
+	size_t runs;
+	size_t first;
+	size_t count;
+	int started;
+	int stop;
+} QUADAHEAD;
+
+void *quad_ahead_thread(void *arg)
+{
+	QUADAHEAD *ra = (QUADAHEAD *) arg;
+	QUADIO *io;
+	size_t result;
+
+	pthread_mutex_lock(&ra->lock);
+
+	while (1)
+	{
+		while (ra->count == 0 && ra->stop == 0)
+		{
+			pthread_cond_wait(&ra->cond, &ra->lock);
+		}
+		if (ra->count == 0)
+		{
+			break;
+		}
+		io = &ra->io[ra->queue[ra->first]];
+
+		ra->first = (ra->first + 1) % ra->runs;
+		ra->count--;
+
+		pthread_mutex_unlock(&ra->lock);
+
+		result = quad_io_transfer(io);
+
+		pthread_mutex_lock(&ra->lock);
+
+		io->result = result;
+		io->busy = 0;
+
+		pthread_cond_broadcast(&ra->cond);
+	}
+	pthread_mutex_unlock(&ra->lock);
+
+	return NULL;
+}
+
+// returns 0 if out of memory, if no thread can be created the reads are
+// carried out when requested
+
+int quad_ahead_init(QUADAHEAD *ra, int fd, size_t runs)
+{
+	size_t run;
+
+	memset(ra, 0, sizeof(QUADAHEAD));
+
+	ra->io = (QUADIO *) quad_malloc(runs * sizeof(QUADIO));
+	ra->queue = (size_t *) quad_malloc(runs * sizeof(size_t));
+
+	if (ra->io == NULL || ra->queue == NULL)
+	{
+		quad_free(ra->queue);
+		quad_free(ra->io);
+
+		return 0;
+	}
+	memset(ra->io, 0, runs * sizeof(QUADIO));
+
+	for (run = 0 ; run < runs ; run++)
+	{
+		ra->io[run].fd = fd;
+	}
+	ra->runs = runs;
+
+	pthread_mutex_init(&ra->lock, NULL);
+	pthread_cond_init(&ra->cond, NULL);
+
+	ra->started = pthread_create(&ra->thread, NULL, quad_ahead_thread, ra) == 0;
+
+	return 1;
+}
+
+// waits for the queued reads to finish
+
+void quad_ahead_free(QUADAHEAD *ra)
+{
+	if (ra->started)
+	{
+		pthread_mutex_lock(&ra->lock);
+
+		ra->stop = 1;
+
+		pthread_cond_broadcast(&ra->cond);
+		pthread_mutex_unlock(&ra->lock);
+
+		pthread_join(ra->thread, NULL);
+	}
+	pthread_cond_destroy(&ra->cond);
+	pthread_mutex_destroy(&ra->lock);
+
+	quad_free(ra->queue);
+	quad_free(ra->io);
+}
+
+// queues a read of the next part of a run into buffer, an empty request marks
+// the end of the run
+
+void quad_ahead_start(QUADAHEAD *ra, size_t run, char *buffer, size_t bytes, off_t *offset, off_t end)
+{
+	QUADIO *io = &ra->io[run];
+
+	if ((off_t) bytes > end - *offset)
+	{
+		bytes = end - *offset;
+	}
+	io->buffer = buffer;
+	io->bytes = bytes;
+	io->offset = *offset;
+	io->result = 0;
+
+	*offset += bytes;
+
+	if (ra->started == 0)
+	{
+		io->result = quad_io_transfer(io);
+
+		return;
+	}
+	pthread_mutex_lock(&ra->lock);
+
+	io->busy = 1;
+
+	ra->queue[(ra->first + ra->count++) % ra->runs] = run;
+
+	pthread_cond_broadcast(&ra->cond);
+	pthread_mutex_unlock(&ra->lock);
+}
+
+// returns the number of bytes read by the last request of a run
+
+size_t quad_ahead_finish(QUADAHEAD *ra, size_t run)
+{
+	QUADIO *io = &ra->io[run];
+
+	if (ra->started)
+	{
+		pthread_mutex_lock(&ra->lock);
+
+		while (io->busy)
+		{
+			pthread_cond_wait(&ra->cond, &ra->lock);
+		}
+		pthread_mutex_unlock(&ra->lock);
+	}
+	return io->result;
+}
+
+// each run has two buffers of bytes starting at buffer, waits for the read
+// ahead buffer to fill, makes it current and queues a read of the next part
+// into the other buffer. The head is set to NULL once the run is exhausted,
+// returns an errno value
+
+int quad_ext_refill(QUADLOSER *lt, QUADAHEAD *ra, size_t run, char *buffer, size_t bytes, off_t *offset, off_t *end, char **limit)
+{
+	QUADIO *io = &ra->io[run];
+	char *ready = io->buffer;
+
+	if (quad_ahead_finish(ra, run) != io->bytes)
+	{
+		return io->error ? io->error : EIO;
+	}
+	if (io->bytes == 0)
+	{
+		lt->head[run] = NULL;
+
+		return 0;
+	}
+	lt->head[run] = ready;
+	limit[run] = ready + io->bytes;
+
+	quad_ahead_start(ra, run, ready == buffer ? buffer + bytes : buffer, bytes, &offset[run], end[run]);
+
+	return 0;
+}
+
+// merges the runs of the spill file into the output, returns an errno value
+
+int quad_ext_merge(int spill, int out, size_t nmemb, size_t chunk, size_t size, CMPFUNC *cmp, size_t prim, size_t memory)
+{
+	size_t runs = (nmemb + chunk - 1) / chunk;
+	size_t in_size, out_size, run, fill;
+	off_t *offset, *end, written;
+	char *input, *output[2], **limit;
+	CMPFUNC *merge = cmp;
+	QUADLOSER lt;
+	QUADAHEAD ra;
+	QUADIO wr;
+	int error = 0, flip = 0;
+
+	in_size = memory / 4 / runs / size;
+	in_size = (in_size ? in_size : 1) * size;
+
+	out_size = memory / 4 / size;
+	out_size = (out_size ? out_size : 1) * size;
+
+	if (merge == NULL)
+	{
+		switch (prim)
+		{
+			case 4: case 6: merge = quad_ext_cmp_int32; break;
+			case 5: merge = quad_ext_cmp_uint32; break;
+			case 7: case 8: merge = quad_ext_cmp_int64; break;
+			case 9: merge = quad_ext_cmp_uint64; break;
+		}
+	}
+
+	if (quad_loser_init(&lt, runs, merge) == 0)
+	{
+		return ENOMEM;
+	}
+	input = (char *) quad_malloc(runs * in_size * 2);
+	output[0] = (char *) quad_malloc(out_size * 2);
+	offset = (off_t *) quad_malloc(runs * 2 * sizeof(off_t));
+	limit = (char **) quad_malloc(runs * sizeof(char *));
+
+	memset(&wr, 0, sizeof(QUADIO));
+
+	if (input == NULL || output[0] == NULL || offset == NULL || limit == NULL)
+	{
+		error = ENOMEM;
+	}
+	else if (quad_ahead_init(&ra, spill, runs) == 0)
+	{
+		error = ENOMEM;
+	}
+
+	if (error == 0)
+	{
+		output[1] = output[0] + out_size;
+		end = offset + runs;
+
+		// the first part of every run is queued before any is waited on
+
+		for (run = 0 ; run < runs ; run++)
+		{
+			offset[run] = (off_t) run * chunk * size;
+			end[run] = run + 1 == runs ? (off_t) nmemb * size : offset[run] + (off_t) chunk * size;
+
+			quad_ahead_start(&ra, run, input + run * in_size * 2, in_size, &offset[run], end[run]);
+		}
+
+		for (run = 0 ; run < runs && error == 0 ; run++)
+		{
+			error = quad_ext_refill(&lt, &ra, run, input + run * in_size * 2, in_size, offset, end, limit);
+		}
+		quad_loser_build(&lt);
+
+		fill = 0;
+		written = 0;
+
+		while (error == 0 && lt.head[lt.tree[0]])
+		{
+			run = lt.tree[0];
+
+			memcpy(output[flip] + fill, lt.head[run], size);
+
+			fill += size;
+			lt.head[run] += size;
+
+			if (lt.head[run] == limit[run])
+			{
+				error = quad_ext_refill(&lt, &ra, run, input + run * in_size * 2, in_size, offset, end, limit);
+			}
+			quad_loser_replay(&lt);
+
+			if (fill == out_size || lt.head[lt.tree[0]] == NULL)
+			{
+				quad_ext_output(output[flip], fill / size, cmp, prim);
+
+				if (quad_io_finish(&wr) != wr.bytes)
+				{
+					error = wr.error ? wr.error : EIO;
+				}
+				quad_io_start(&wr, out, 1, output[flip], fill, written);
+
+				written += fill;
+				flip = !flip;
+				fill = 0;
+			}
+		}
+		if (quad_io_finish(&wr) != wr.bytes && error == 0)
+		{
+			error = wr.error ? wr.error : EIO;
+		}
+		quad_ahead_free(&ra);
+	}
+	quad_free(limit);
+	quad_free(offset);
+	quad_free(output[0]);
+	quad_free(input);
+	quad_loser_free(&lt);
+
+	return error;
+}
+
+// sorts the input file into the output file, which may be the same file,
+// returns an errno value
+
+int quad_ext_sort_file(const char *input, const char *output, size_t size, CMPFUNC *cmp, size_t prim, size_t memory)
+{
+	size_t nmemb, chunk, runs, run, cnt, bytes;
+	char *buffer[3] = { NULL, NULL, NULL };
+	struct stat st;
+	QUADIO rd, wr;
+	int in, out, spill = -1, error = 0;
+
+	if (size == 0)
+	{
+		return EINVAL;
+	}
+	in = open(input, O_RDONLY);
+
+	if (in == -1)
+	{
+		return errno;
+	}
+
+	if (fstat(in, &st) == -1)
+	{
+		error = errno;
+		close(in);
+		return error;
+	}
+
+	if (st.st_size % size)
+	{
+		close(in);
+		return EINVAL;
+	}
+	nmemb = st.st_size / size;
+
+	chunk = memory / 4 / size;
+	chunk = chunk ? chunk : 1;
+
+	memset(&rd, 0, sizeof(QUADIO));
+	memset(&wr, 0, sizeof(QUADIO));
+
+	// a file that fits the budget is sorted in memory
+
+	if (nmemb <= chunk)
+	{
+		buffer[0] = (char *) quad_malloc(nmemb * size + 1);
+
+		if (buffer[0] == NULL)
+		{
+			close(in);
+			return ENOMEM;
+		}
+		rd.fd = in;
+		rd.buffer = buffer[0];
+		rd.bytes = nmemb * size;
+
+		if (quad_io_transfer(&rd) != rd.bytes)
+		{
+			error = rd.error ? rd.error : EIO;
+		}
+		close(in);
+
+		if (error == 0)
+		{
+			quad_ext_sort(buffer[0], nmemb, size, cmp, prim);
+			quad_ext_output(buffer[0], nmemb, cmp, prim);
+
+			out = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+			if (out == -1)
+			{
+				error = errno;
+			}
+			else
+			{
+				wr.fd = out;
+				wr.write = 1;
+				wr.buffer = buffer[0];
+				wr.bytes = rd.bytes;
+
+				if (quad_io_transfer(&wr) != wr.bytes)
+				{
+					error = wr.error ? wr.error : EIO;
+				}
+				if (close(out) == -1 && error == 0)
+				{
+					error = errno;
+				}
+			}
+		}
+		quad_free(buffer[0]);
+
+		return error;
+	}
+	runs = (nmemb + chunk - 1) / chunk;
+
+	for (cnt = 0 ; cnt < 3 ; cnt++)
+	{
+		buffer[cnt] = (char *) quad_malloc(chunk * size);
+
+		if (buffer[cnt] == NULL)
+		{
+			error = ENOMEM;
+		}
+	}
+	spill = error ? -1 : quad_ext_tmpfile();
+
+	if (error == 0 && spill == -1)
+	{
+		error = errno;
+	}
+
+	// chunk n + 1 is read and run n - 1 is written while chunk n is sorted
+
+	if (error == 0)
+	{
+		quad_io_start(&rd, in, 0, buffer[0], chunk * size, 0);
+	}
+
+	for (run = 0 ; run < runs && error == 0 ; run++)
+	{
+		cnt = run + 1 == runs ? nmemb - run * chunk : chunk;
+		bytes = cnt * size;
+
+		if (quad_io_finish(&rd) != bytes)
+		{
+			error = rd.error ? rd.error : EIO;
+			break;
+		}
+
+		if (run + 1 < runs)
+		{
+			quad_io_start(&rd, in, 0, buffer[(run + 1) % 3], chunk * size, (off_t) (run + 1) * chunk * size);
+		}
+		quad_ext_sort(buffer[run % 3], cnt, size, cmp, prim);
+
+		if (quad_io_finish(&wr) != wr.bytes)
+		{
+			error = wr.error ? wr.error : EIO;
+			break;
+		}
+		quad_io_start(&wr, spill, 1, buffer[run % 3], bytes, (off_t) run * chunk * size);
+	}
+	quad_io_finish(&rd);
+
+	if (quad_io_finish(&wr) != wr.bytes && error == 0)
+	{
+		error = wr.error ? wr.error : EIO;
+	}
+	close(in);
+
+	for (cnt = 0 ; cnt < 3 ; cnt++)
+	{
+		quad_free(buffer[cnt]);
+	}
+
+	if (error == 0)
+	{
+		out = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+		if (out == -1)
+		{
+			error = errno;
+		}
+		else
+		{
+			error = quad_ext_merge(spill, out, nmemb, chunk, size, cmp, prim, memory);
+
+			if (close(out) == -1 && error == 0)
+			{
+				error = errno;
+			}
+		}
+	}
+	if (spill != -1)
+	{
+		close(spill);
+	}
+	return error;
+}
+
+// Sorts a file of records of size bytes with the comparison function, using
+// about memory bytes of memory. The output may be the input file. Returns 0
+// on success, or -1 with errno set.
+
+int quadsort_file(const char *input, const char *output, size_t size, CMPFUNC *cmp, size_t memory)
+{
+	int error = quad_ext_sort_file(input, output, size, cmp, 0, memory);
+
+	if (error)
+	{
+		errno = error;
+
+		return -1;
+	}
+	return 0;
+}
+
+// Sorts a file of primitives, prim uses the quadsort_prim() numbering.
+
+int quadsort_file_prim(const char *input, const char *output, size_t prim, size_t memory)
+{
+	int error;
+
+	switch (prim)
+	{
+		case 4: case 5: case 6:
+			error = quad_ext_sort_file(input, output, 4, NULL, prim, memory);
+			break;
+		case 7: case 8: case 9:
+			error = quad_ext_sort_file(input, output, 8, NULL, prim, memory);
+			break;
+		default:
+			error = EINVAL;
+			break;
+	}
+
+	if (error)
+	{
+		errno = error;
+
+		return -1;
+	}
+	return 0;
+}
+
+#endif
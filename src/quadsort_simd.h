@@ -0,0 +1,336 @@
+// quadsort 1.2.1.3 - Igor van den Hoven ivdhoven@gmail.com
+
+// Sorting networks for the primitive quadsort_prim() instantiations. These
+// are only used when compiled with -mavx2 or -march=native on a machine that
+// supports it.
+
+// All comparisons are signed, unsigned integers are converted by flipping the
+// sign bit with the bias on load and store. Equal integers are identical, so
+// the unstable networks produce the same output as the scalar merges.
+
+#ifndef QUADSORT_SIMD_H
+#define QUADSORT_SIMD_H
+
+#include <immintrin.h>
+
+//////////////////////////////////////////////////////////
+// ┌───────────────────────────────────────────────────┐//
+// │       ██████┐ ██████┐    ██████┐ ██████┐████████┐ │//
+// │       └────██┐└────██┐   ██┌──██┐└─██┌─┘└──██┌──┘ │//
+// │        █████┌┘ █████┌┘   ██████┌┘  ██│     ██│    │//
+// │        └───██┐██┌───┘    ██┌──██┐  ██│     ██│    │//
+// │       ██████┌┘███████┐   ██████┌┘██████┐   ██│    │//
+// │       └─────┘ └──────┘   └─────┘ └─────┘   └─┘    │//
+// └───────────────────────────────────────────────────┘//
+//////////////////////////////////////////////////////////
+
+// sorts a bitonic vector of 8 elements
+
+__m256i quad_bitonic_epi32(__m256i vec)
+{
+	__m256i tmp, lo, hi;
+
+	tmp = _mm256_permute2x128_si256(vec, vec, 1);
+	lo = _mm256_min_epi32(vec, tmp); hi = _mm256_max_epi32(vec, tmp);
+	vec = _mm256_blend_epi32(lo, hi, 0xF0);
+
+	tmp = _mm256_shuffle_epi32(vec, _MM_SHUFFLE(1, 0, 3, 2));
+	lo = _mm256_min_epi32(vec, tmp); hi = _mm256_max_epi32(vec, tmp);
+	vec = _mm256_blend_epi32(lo, hi, 0xCC);
+
+	tmp = _mm256_shuffle_epi32(vec, _MM_SHUFFLE(2, 3, 0, 1));
+	lo = _mm256_min_epi32(vec, tmp); hi = _mm256_max_epi32(vec, tmp);
+	return _mm256_blend_epi32(lo, hi, 0xAA);
+}
+
+__m256i quad_reverse_epi32(__m256i vec)
+{
+	return _mm256_permutevar8x32_epi32(vec, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+// merges two sorted vectors, the lower half ends up in va, the upper in vb
+
+void quad_merge_sixteen_epi32(__m256i *va, __m256i *vb)
+{
+	__m256i rev = quad_reverse_epi32(*vb);
+
+	*vb = quad_bitonic_epi32(_mm256_max_epi32(*va, rev));
+	*va = quad_bitonic_epi32(_mm256_min_epi32(*va, rev));
+}
+
+// sorts 8 elements consisting of 4 sorted pairs, replaces quad_swap_merge
+
+void quad_swap_merge_epi32(void *array, int bias)
+{
+	__m256i flip = _mm256_set1_epi32(bias);
+	__m256i vec, tmp, lo, hi;
+
+	vec = _mm256_xor_si256(_mm256_loadu_si256((__m256i *) array), flip);
+
+	vec = _mm256_shuffle_epi32(vec, _MM_SHUFFLE(2, 3, 1, 0));
+
+	tmp = _mm256_shuffle_epi32(vec, _MM_SHUFFLE(1, 0, 3, 2));
+	lo = _mm256_min_epi32(vec, tmp); hi = _mm256_max_epi32(vec, tmp);
+	vec = _mm256_blend_epi32(lo, hi, 0xCC);
+
+	tmp = _mm256_shuffle_epi32(vec, _MM_SHUFFLE(2, 3, 0, 1));
+	lo = _mm256_min_epi32(vec, tmp); hi = _mm256_max_epi32(vec, tmp);
+	vec = _mm256_blend_epi32(lo, hi, 0xAA);
+
+	vec = _mm256_permutevar8x32_epi32(vec, _mm256_setr_epi32(0, 1, 2, 3, 7, 6, 5, 4));
+
+	_mm256_storeu_si256((__m256i *) array, _mm256_xor_si256(quad_bitonic_epi32(vec), flip));
+}
+
+// merges 4 sorted blocks of 8 elements into a sorted block of 32 elements
+
+void quad_merge_thirtytwo_epi32(void *array, int bias)
+{
+	__m256i flip = _mm256_set1_epi32(bias);
+	__m256i *pta = (__m256i *) array;
+	__m256i v0, v1, v2, v3, r0, r1, lo, hi;
+
+	v0 = _mm256_xor_si256(_mm256_loadu_si256(pta + 0), flip);
+	v1 = _mm256_xor_si256(_mm256_loadu_si256(pta + 1), flip);
+	v2 = _mm256_xor_si256(_mm256_loadu_si256(pta + 2), flip);
+	v3 = _mm256_xor_si256(_mm256_loadu_si256(pta + 3), flip);
+
+	quad_merge_sixteen_epi32(&v0, &v1);
+	quad_merge_sixteen_epi32(&v2, &v3);
+
+	r0 = quad_reverse_epi32(v3);
+	r1 = quad_reverse_epi32(v2);
+
+	v2 = _mm256_max_epi32(v0, r0); v0 = _mm256_min_epi32(v0, r0);
+	v3 = _mm256_max_epi32(v1, r1); v1 = _mm256_min_epi32(v1, r1);
+
+	lo = _mm256_min_epi32(v0, v1); hi = _mm256_max_epi32(v0, v1);
+
+	_mm256_storeu_si256(pta + 0, _mm256_xor_si256(quad_bitonic_epi32(lo), flip));
+	_mm256_storeu_si256(pta + 1, _mm256_xor_si256(quad_bitonic_epi32(hi), flip));
+
+	lo = _mm256_min_epi32(v2, v3); hi = _mm256_max_epi32(v2, v3);
+
+	_mm256_storeu_si256(pta + 2, _mm256_xor_si256(quad_bitonic_epi32(lo), flip));
+	_mm256_storeu_si256(pta + 3, _mm256_xor_si256(quad_bitonic_epi32(hi), flip));
+}
+
+// merges the 8 smallest elements of two sorted arrays into dest, returns the
+// number of elements taken from the left array. Ties go to the left side.
+
+size_t quad_head_merge_epi32(void *dest, void *ptl, void *ptr, int bias)
+{
+	__m256i flip = _mm256_set1_epi32(bias);
+	__m256i va, vb, gt;
+
+	va = _mm256_xor_si256(_mm256_loadu_si256((__m256i *) ptl), flip);
+	vb = quad_reverse_epi32(_mm256_xor_si256(_mm256_loadu_si256((__m256i *) ptr), flip));
+	gt = _mm256_cmpgt_epi32(va, vb);
+
+	_mm256_storeu_si256((__m256i *) dest, _mm256_xor_si256(quad_bitonic_epi32(_mm256_min_epi32(va, vb)), flip));
+
+	return __builtin_ctz(_mm256_movemask_ps(_mm256_castsi256_ps(gt)) | 0x100);
+}
+
+// merges the 8 largest elements of two sorted arrays ending at tpl and tpr
+// into the 8 elements ending at dest, returns the number taken from the left
+
+size_t quad_tail_merge_epi32(void *dest, void *tpl, void *tpr, int bias)
+{
+	__m256i flip = _mm256_set1_epi32(bias);
+	__m256i va, vb, gt;
+
+	va = _mm256_xor_si256(_mm256_loadu_si256((__m256i *) ((int *) tpl - 7)), flip);
+	vb = quad_reverse_epi32(_mm256_xor_si256(_mm256_loadu_si256((__m256i *) ((int *) tpr - 7)), flip));
+	gt = _mm256_cmpgt_epi32(va, vb);
+
+	_mm256_storeu_si256((__m256i *) ((int *) dest - 7), _mm256_xor_si256(quad_bitonic_epi32(_mm256_max_epi32(va, vb)), flip));
+
+	return 8 - __builtin_ctz(_mm256_movemask_ps(_mm256_castsi256_ps(gt)) | 0x100);
+}
+
+//////////////////////////////////////////////////////////
+// ┌───────────────────────────────────────────────────┐//
+// │        █████┐ ██┐  ██┐   ██████┐ ██████┐████████┐ │//
+// │       ██┌───┘ ██│  ██│   ██┌──██┐└─██┌─┘└──██┌──┘ │//
+// │       ██████┐ ███████│   ██████┌┘  ██│     ██│    │//
+// │       ██┌──██┐└────██│   ██┌──██┐  ██│     ██│    │//
+// │       └█████┌┘     ██│   ██████┌┘██████┐   ██│    │//
+// │        └────┘      └─┘   └─────┘ └─────┘   └─┘    │//
+// └───────────────────────────────────────────────────┘//
+//////////////////////////////////////////////////////////
+
+// AVX2 lacks 64 bit min and max, so they're emulated with a compare and blend
+
+#define quad_minmax_epi64(va, vb, lo, hi)  \
+{  \
+	__m256i quad_a = va, quad_b = vb, quad_gt = _mm256_cmpgt_epi64(quad_a, quad_b);  \
+	lo = _mm256_blendv_epi8(quad_a, quad_b, quad_gt);  \
+	hi = _mm256_blendv_epi8(quad_b, quad_a, quad_gt);  \
+}
+
+// sorts a bitonic vector of 4 elements
+
+__m256i quad_bitonic_epi64(__m256i vec)
+{
+	__m256i tmp, lo, hi;
+
+	tmp = _mm256_permute4x64_epi64(vec, _MM_SHUFFLE(1, 0, 3, 2));
+	quad_minmax_epi64(vec, tmp, lo, hi);
+	vec = _mm256_blend_epi32(lo, hi, 0xF0);
+
+	tmp = _mm256_permute4x64_epi64(vec, _MM_SHUFFLE(2, 3, 0, 1));
+	quad_minmax_epi64(vec, tmp, lo, hi);
+	return _mm256_blend_epi32(lo, hi, 0xCC);
+}
+
+__m256i quad_reverse_epi64(__m256i vec)
+{
+	return _mm256_permute4x64_epi64(vec, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+// sorts a bitonic sequence of 4 vectors
+
+void quad_bitonic_sixteen_epi64(__m256i *vec)
+{
+	quad_minmax_epi64(vec[0], vec[2], vec[0], vec[2]);
+	quad_minmax_epi64(vec[1], vec[3], vec[1], vec[3]);
+
+	quad_minmax_epi64(vec[0], vec[1], vec[0], vec[1]);
+	quad_minmax_epi64(vec[2], vec[3], vec[2], vec[3]);
+
+	vec[0] = quad_bitonic_epi64(vec[0]);
+	vec[1] = quad_bitonic_epi64(vec[1]);
+	vec[2] = quad_bitonic_epi64(vec[2]);
+	vec[3] = quad_bitonic_epi64(vec[3]);
+}
+
+// merges two sorted runs of 2 vectors, vec[0] to vec[3] hold the result
+
+void quad_merge_sixteen_epi64(__m256i *vec)
+{
+	__m256i r0, r1;
+
+	r0 = quad_reverse_epi64(vec[3]);
+	r1 = quad_reverse_epi64(vec[2]);
+
+	quad_minmax_epi64(vec[0], r0, vec[0], vec[2]);
+	quad_minmax_epi64(vec[1], r1, vec[1], vec[3]);
+
+	quad_minmax_epi64(vec[0], vec[1], vec[0], vec[1]);
+	quad_minmax_epi64(vec[2], vec[3], vec[2], vec[3]);
+
+	vec[0] = quad_bitonic_epi64(vec[0]);
+	vec[1] = quad_bitonic_epi64(vec[1]);
+	vec[2] = quad_bitonic_epi64(vec[2]);
+	vec[3] = quad_bitonic_epi64(vec[3]);
+}
+
+// sorts 8 elements consisting of 4 sorted pairs, replaces quad_swap_merge
+
+void quad_swap_merge_epi64(void *array, long long bias)
+{
+	__m256i flip = _mm256_set1_epi64x(bias);
+	__m256i *pta = (__m256i *) array;
+	__m256i v0, v1, lo, hi;
+
+	v0 = _mm256_xor_si256(_mm256_loadu_si256(pta + 0), flip);
+	v1 = _mm256_xor_si256(_mm256_loadu_si256(pta + 1), flip);
+
+	v0 = quad_bitonic_epi64(_mm256_permute4x64_epi64(v0, _MM_SHUFFLE(2, 3, 1, 0)));
+	v1 = quad_bitonic_epi64(_mm256_permute4x64_epi64(v1, _MM_SHUFFLE(2, 3, 1, 0)));
+	v1 = quad_reverse_epi64(v1);
+
+	quad_minmax_epi64(v0, v1, lo, hi);
+
+	_mm256_storeu_si256(pta + 0, _mm256_xor_si256(quad_bitonic_epi64(lo), flip));
+	_mm256_storeu_si256(pta + 1, _mm256_xor_si256(quad_bitonic_epi64(hi), flip));
+}
+
+// merges 4 sorted blocks of 8 elements into a sorted block of 32 elements
+
+void quad_merge_thirtytwo_epi64(void *array, long long bias)
+{
+	__m256i flip = _mm256_set1_epi64x(bias);
+	__m256i *pta = (__m256i *) array;
+	__m256i vec[8], rev[4];
+	int cnt;
+
+	for (cnt = 0 ; cnt < 8 ; cnt++)
+	{
+		vec[cnt] = _mm256_xor_si256(_mm256_loadu_si256(pta + cnt), flip);
+	}
+
+	quad_merge_sixteen_epi64(vec + 0);
+	quad_merge_sixteen_epi64(vec + 4);
+
+	for (cnt = 0 ; cnt < 4 ; cnt++)
+	{
+		rev[cnt] = quad_reverse_epi64(vec[7 - cnt]);
+	}
+
+	for (cnt = 0 ; cnt < 4 ; cnt++)
+	{
+		quad_minmax_epi64(vec[cnt], rev[cnt], vec[cnt], vec[cnt + 4]);
+	}
+
+	quad_bitonic_sixteen_epi64(vec + 0);
+	quad_bitonic_sixteen_epi64(vec + 4);
+
+	for (cnt = 0 ; cnt < 8 ; cnt++)
+	{
+		_mm256_storeu_si256(pta + cnt, _mm256_xor_si256(vec[cnt], flip));
+	}
+}
+
+// merges the 8 smallest elements of two sorted arrays into dest, returns the
+// number of elements taken from the left array. Ties go to the left side.
+
+size_t quad_head_merge_epi64(void *dest, void *ptl, void *ptr, long long bias)
+{
+	__m256i flip = _mm256_set1_epi64x(bias);
+	__m256i *pta = (__m256i *) ptl, *ptb = (__m256i *) ptr, *ptd = (__m256i *) dest;
+	__m256i a0, a1, b0, b1, g0, g1, lo, hi;
+
+	a0 = _mm256_xor_si256(_mm256_loadu_si256(pta + 0), flip);
+	a1 = _mm256_xor_si256(_mm256_loadu_si256(pta + 1), flip);
+	b0 = quad_reverse_epi64(_mm256_xor_si256(_mm256_loadu_si256(ptb + 1), flip));
+	b1 = quad_reverse_epi64(_mm256_xor_si256(_mm256_loadu_si256(ptb + 0), flip));
+
+	g0 = _mm256_cmpgt_epi64(a0, b0);
+	g1 = _mm256_cmpgt_epi64(a1, b1);
+
+	quad_minmax_epi64(_mm256_blendv_epi8(a0, b0, g0), _mm256_blendv_epi8(a1, b1, g1), lo, hi);
+
+	_mm256_storeu_si256(ptd + 0, _mm256_xor_si256(quad_bitonic_epi64(lo), flip));
+	_mm256_storeu_si256(ptd + 1, _mm256_xor_si256(quad_bitonic_epi64(hi), flip));
+
+	return __builtin_ctz(_mm256_movemask_pd(_mm256_castsi256_pd(g0)) | _mm256_movemask_pd(_mm256_castsi256_pd(g1)) << 4 | 0x100);
+}
+
+// merges the 8 largest elements of two sorted arrays ending at tpl and tpr
+// into the 8 elements ending at dest, returns the number taken from the left
+
+size_t quad_tail_merge_epi64(void *dest, void *tpl, void *tpr, long long bias)
+{
+	__m256i flip = _mm256_set1_epi64x(bias);
+	__m256i *pta = (__m256i *) ((long long *) tpl - 7), *ptb = (__m256i *) ((long long *) tpr - 7), *ptd = (__m256i *) ((long long *) dest - 7);
+	__m256i a0, a1, b0, b1, g0, g1, lo, hi;
+
+	a0 = _mm256_xor_si256(_mm256_loadu_si256(pta + 0), flip);
+	a1 = _mm256_xor_si256(_mm256_loadu_si256(pta + 1), flip);
+	b0 = quad_reverse_epi64(_mm256_xor_si256(_mm256_loadu_si256(ptb + 1), flip));
+	b1 = quad_reverse_epi64(_mm256_xor_si256(_mm256_loadu_si256(ptb + 0), flip));
+
+	g0 = _mm256_cmpgt_epi64(a0, b0);
+	g1 = _mm256_cmpgt_epi64(a1, b1);
+
+	quad_minmax_epi64(_mm256_blendv_epi8(b0, a0, g0), _mm256_blendv_epi8(b1, a1, g1), lo, hi);
+
+	_mm256_storeu_si256(ptd + 0, _mm256_xor_si256(quad_bitonic_epi64(lo), flip));
+	_mm256_storeu_si256(ptd + 1, _mm256_xor_si256(quad_bitonic_epi64(hi), flip));
+
+	return 8 - __builtin_ctz(_mm256_movemask_pd(_mm256_castsi256_pd(g0)) | _mm256_movemask_pd(_mm256_castsi256_pd(g1)) << 4 | 0x100);
+}
+
+#endif